@@ -9,6 +9,8 @@
 #define GLEW_STATIC
 #include "GL\glew.h"
 
+#include <algorithm>
+
 #include "game.h"
 #include "resource_manager.h"
 
@@ -20,6 +22,8 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
 const GLuint SCREEN_WIDTH = 800;
 // The height of the screen
 const GLuint SCREEN_HEIGHT = 600;
+// Longest frame the simulation catches up on; after a longer stall the game slows down instead of running lots of steps at once
+const GLfloat MAX_FRAME_TIME = 0.25f;
 
 Game Breakout(SCREEN_WIDTH, SCREEN_HEIGHT);
 
@@ -52,9 +56,8 @@ int main(int argc, char *argv[])
 	// DeltaTime variables
 	GLfloat deltaTime = 0.0f;
 	GLfloat lastFrame = 0.0f;
-
-	// Start Game within Menu State
-	Breakout.State = GAME_ACTIVE;
+	// Time rendered but not simulated yet
+	GLfloat accumulator = 0.0f;
 
 	while (!glfwWindowShouldClose(window))
 	{
@@ -64,17 +67,28 @@ int main(int argc, char *argv[])
 		lastFrame = currentFrame;
 		glfwPollEvents();
 
-		//deltaTime = 0.001f;
-		// Manage user input
-		Breakout.ProcessInput(deltaTime);
-
-		// Update Game state
-		Breakout.Update(deltaTime);
-
-		// Render
+		// The loading screen isn't simulated, it just uploads for a while each frame
+		if (Breakout.State == GAME_LOADING)
+			Breakout.Update(deltaTime);
+		else
+		{
+			// Run as many fixed steps as fit in the time that passed; the rest carries over to the next frame
+			accumulator += std::min(deltaTime, MAX_FRAME_TIME);
+			while (accumulator >= SIMULATION_STEP)
+			{
+				Breakout.SaveState();
+				// Manage user input
+				Breakout.ProcessInput(SIMULATION_STEP);
+				// Update Game state
+				Breakout.Update(SIMULATION_STEP);
+				accumulator -= SIMULATION_STEP;
+			}
+		}
+
+		// Render, in between the last two steps by how far we are into the next one
 		glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
 		glClear(GL_COLOR_BUFFER_BIT);
-		Breakout.Render();
+		Breakout.Render(accumulator / SIMULATION_STEP);
 
 		glfwSwapBuffers(window);
 	}
@@ -0,0 +1,164 @@
+/*******************************************************************
+** This code is part of Breakout.
+**
+** Breakout is free software: you can redistribute it and/or modify
+** it under the terms of the CC BY 4.0 license as published by
+** Creative Commons, either version 4 of the License, or (at your
+** option) any later version.
+******************************************************************/
+#include "baked_texture.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <sys/stat.h>
+
+#include <SOIL.h>
+
+// Bump whenever the layout of baked files changes
+const uint32_t BAKED_TEXTURE_VERSION = 1;
+// Larger than any texture GL takes; a header claiming more is corrupt
+const uint32_t BAKED_TEXTURE_MAX_SIZE = 65536;
+
+// Size of a mip level of a width x height image
+static GLuint levelSize(GLuint size, GLuint level)
+{
+	size >>= level;
+	return size > 0 ? size : 1;
+}
+
+// Number of levels of a full mip chain down to 1x1
+static GLuint mipLevels(GLuint width, GLuint height)
+{
+	GLuint levels = 1;
+	while ((width >> levels) > 0 || (height >> levels) > 0)
+		++levels;
+	return levels;
+}
+
+TextureImage::TextureImage()
+	: Width(0), Height(0), Channels(0), Levels(0), Pixels(nullptr), Baked(GL_FALSE)
+{ }
+
+size_t TextureImage::LevelOffset(GLuint level) const
+{
+	size_t offset = 0;
+	for (GLuint i = 0; i < level; ++i)
+		offset += static_cast<size_t>(levelSize(this->Width, i)) * levelSize(this->Height, i) * this->Channels;
+	return offset;
+}
+
+bool TextureImage::Load(const char *file, GLuint channels, GLboolean mipmaps)
+{
+	std::string path = std::string(file) + (channels == 4 ? ".rgba.btex" : ".rgb.btex");
+	struct stat source;
+	GLboolean haveSource = stat(file, &source) == 0;
+	uint64_t sourceSize = haveSource ? static_cast<uint64_t>(source.st_size) : 0;
+	uint64_t sourceTime = haveSource ? static_cast<uint64_t>(source.st_mtime) : 0;
+	// Prefer the baked file; fall back to decoding the source (and bake it for next time)
+	if (this->loadBaked(path, channels, mipmaps, haveSource, sourceSize, sourceTime))
+		return true;
+	if (!haveSource || !this->loadSource(file, channels, mipmaps))
+		return false;
+	this->bake(path, sourceSize, sourceTime);
+	return true;
+}
+
+bool TextureImage::loadBaked(const std::string &path, GLuint channels, GLboolean mipmaps, GLboolean haveSource, uint64_t sourceSize, uint64_t sourceTime)
+{
+	if (!this->mapping.Open(path) || this->mapping.Size() < sizeof(BakedTextureHeader))
+	{
+		this->mapping.Close();
+		return false;
+	}
+	// Validate the header against what we expect; a stale or foreign file (or one missing the mip chain) is simply re-baked
+	BakedTextureHeader header;
+	memcpy(&header, this->mapping.Data(), sizeof(header));
+	this->Width = header.Width;
+	this->Height = header.Height;
+	this->Channels = header.Channels;
+	this->Levels = header.Levels;
+	// The size is checked before LevelOffset walks the levels, so a corrupt header can't make it loop or overflow
+	bool valid = memcmp(header.Magic, "BTEX", 4) == 0 && header.Version == BAKED_TEXTURE_VERSION &&
+		header.Channels == channels && header.Width > 0 && header.Height > 0 &&
+		header.Width <= BAKED_TEXTURE_MAX_SIZE && header.Height <= BAKED_TEXTURE_MAX_SIZE &&
+		header.Levels > 0 && header.Levels <= mipLevels(header.Width, header.Height) &&
+		(!mipmaps || header.Levels == mipLevels(header.Width, header.Height)) &&
+		(!haveSource || (header.SourceSize == sourceSize && header.SourceTime == sourceTime)) &&
+		sizeof(header) + this->LevelOffset(header.Levels) <= this->mapping.Size();
+	if (!valid)
+	{
+		this->mapping.Close();
+		return false;
+	}
+	this->Pixels = this->mapping.Data() + sizeof(header);
+	this->Baked = GL_TRUE;
+	return true;
+}
+
+bool TextureImage::loadSource(const char *file, GLuint channels, GLboolean mipmaps)
+{
+	int width, height;
+	unsigned char *image = SOIL_load_image(file, &width, &height, 0, channels == 4 ? SOIL_LOAD_RGBA : SOIL_LOAD_RGB);
+	if (!image)
+	{
+		std::cout << "ERROR::TEXTURE: Failed to load " << file << std::endl;
+		return false;
+	}
+	this->Width = width;
+	this->Height = height;
+	this->Channels = channels;
+	// Full mip chain down to 1x1, or just the image
+	this->Levels = mipmaps ? mipLevels(this->Width, this->Height) : 1;
+	this->decoded.resize(this->LevelOffset(this->Levels));
+	memcpy(this->decoded.data(), image, static_cast<size_t>(width) * height * channels);
+	SOIL_free_image_data(image);
+	// Each level is a 2x2 box filter of the previous one (edges are clamped for odd sizes)
+	for (GLuint level = 1; level < this->Levels; ++level)
+	{
+		GLuint sw = levelSize(this->Width, level - 1), sh = levelSize(this->Height, level - 1);
+		GLuint dw = levelSize(this->Width, level), dh = levelSize(this->Height, level);
+		const unsigned char *src = this->decoded.data() + this->LevelOffset(level - 1);
+		unsigned char *dst = this->decoded.data() + this->LevelOffset(level);
+		for (GLuint y = 0; y < dh; ++y)
+		{
+			GLuint y0 = std::min(y * 2, sh - 1), y1 = std::min(y * 2 + 1, sh - 1);
+			for (GLuint x = 0; x < dw; ++x)
+			{
+				GLuint x0 = std::min(x * 2, sw - 1), x1 = std::min(x * 2 + 1, sw - 1);
+				for (GLuint c = 0; c < channels; ++c)
+				{
+					GLuint sum = src[(y0 * sw + x0) * channels + c] + src[(y0 * sw + x1) * channels + c] +
+						src[(y1 * sw + x0) * channels + c] + src[(y1 * sw + x1) * channels + c];
+					dst[(y * dw + x) * channels + c] = static_cast<unsigned char>((sum + 2) / 4);
+				}
+			}
+		}
+	}
+	this->Pixels = this->decoded.data();
+	this->Baked = GL_FALSE;
+	return true;
+}
+
+void TextureImage::bake(const std::string &path, uint64_t sourceSize, uint64_t sourceTime) const
+{
+	BakedTextureHeader header;
+	memcpy(header.Magic, "BTEX", 4);
+	header.Version = BAKED_TEXTURE_VERSION;
+	header.Width = this->Width;
+	header.Height = this->Height;
+	header.Channels = this->Channels;
+	header.Levels = this->Levels;
+	header.SourceSize = sourceSize;
+	header.SourceTime = sourceTime;
+	// Not being able to bake (e.g. read-only install) only costs startup time
+	FILE *file = fopen(path.c_str(), "wb");
+	if (!file)
+		return;
+	bool written = fwrite(&header, sizeof(header), 1, file) == 1 &&
+		fwrite(this->decoded.data(), 1, this->decoded.size(), file) == this->decoded.size();
+	fclose(file);
+	if (!written)
+		remove(path.c_str());
+}
@@ -0,0 +1,70 @@
+/*******************************************************************
+** This code is part of Breakout.
+**
+** Breakout is free software: you can redistribute it and/or modify
+** it under the terms of the CC BY 4.0 license as published by
+** Creative Commons, either version 4 of the License, or (at your
+** option) any later version.
+******************************************************************/
+#ifndef BAKED_TEXTURE_H
+#define BAKED_TEXTURE_H
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "mapped_file.h"
+
+
+// Header of a baked texture file. It is followed by the raw texels of
+// every mip level, largest first, tightly packed (1 byte alignment).
+struct BakedTextureHeader {
+	char     Magic[4];   // "BTEX"
+	uint32_t Version;
+	uint32_t Width, Height;
+	uint32_t Channels;   // 3 (RGB) or 4 (RGBA)
+	uint32_t Levels;     // Number of mip levels stored
+	uint64_t SourceSize; // Size and modification time of the image it was baked from,
+	uint64_t SourceTime; // used to notice when the source changed
+};
+
+
+// TextureImage holds the texels of an image file ready for upload. If a
+// baked version of the file (file + ".rgb.btex" or ".rgba.btex") exists
+// and is up to date, it is memory-mapped and Pixels points straight into
+// the mapping. Otherwise the source is decoded with SOIL, its mip levels
+// are generated and the result is baked to disk for the next launch.
+// Images only needed at full size (atlas pages sample level 0 only) can be
+// loaded without the mip chain; they accept a baked file that has one.
+class TextureImage
+{
+public:
+	GLuint Width, Height, Channels, Levels;
+	// Texels of all levels, largest first; valid as long as this object lives
+	const unsigned char *Pixels;
+	// Whether the texels came from a baked file
+	GLboolean Baked;
+	// Constructor
+	TextureImage();
+	// Loads the image with the given number of channels (3 or 4), with or without its mip chain; returns false if neither version could be read
+	bool Load(const char *file, GLuint channels, GLboolean mipmaps = GL_TRUE);
+	// Byte offset of a mip level within Pixels
+	size_t LevelOffset(GLuint level) const;
+private:
+	// Memory mapping of the baked file (unmapped with this object)
+	MappedFile mapping;
+	// Texels decoded from the source when there was no (valid) baked file
+	std::vector<unsigned char> decoded;
+	// Maps a baked file and checks it matches the source stamp
+	bool loadBaked(const std::string &path, GLuint channels, GLboolean mipmaps, GLboolean haveSource, uint64_t sourceSize, uint64_t sourceTime);
+	// Decodes the source file and builds its mip chain if asked to
+	bool loadSource(const char *file, GLuint channels, GLboolean mipmaps);
+	// Writes the decoded texels as a baked file
+	void bake(const std::string &path, uint64_t sourceSize, uint64_t sourceTime) const;
+	// Not copyable, it owns the mapping
+	TextureImage(const TextureImage&);
+	TextureImage &operator=(const TextureImage&);
+};
+
+#endif
\ No newline at end of file
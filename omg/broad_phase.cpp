@@ -0,0 +1,137 @@
+/*******************************************************************
+** This code is part of Breakout.
+**
+** Breakout is free software: you can redistribute it and/or modify
+** it under the terms of the CC BY 4.0 license as published by
+** Creative Commons, either version 4 of the License, or (at your
+** option) any later version.
+******************************************************************/
+#include "broad_phase.h"
+
+#include <algorithm>
+
+
+BroadPhase::BroadPhase()
+	: tallest(0.0f)
+{
+
+}
+
+BroadPhase::Group &BroadPhase::group(GLfloat speed)
+{
+	// Levels have only a handful of speeds, so groups are found by a linear search
+	GLuint g = 0;
+	while (g < this->groups.size() && this->groups[g].Speed != speed)
+		++g;
+	if (g == this->groups.size())
+	{
+		this->groups.push_back(Group());
+		this->groups.back().Speed = speed;
+		this->groups.back().Offset = 0.0;
+		this->groups.back().Cursor = 0;
+	}
+	return this->groups[g];
+}
+
+void BroadPhase::Build(const std::vector<GameObject> &objects)
+{
+	this->groups.clear();
+	this->tallest = 0.0f;
+	for (GLuint i = 0; i < objects.size(); ++i)
+	{
+		Entry entry = { objects[i].Position.y, i };
+		this->group(objects[i].Velocity.y).Entries.push_back(entry);
+		this->tallest = std::max(this->tallest, objects[i].Size.y);
+	}
+	for (Group &group : this->groups)
+		std::stable_sort(group.Entries.begin(), group.Entries.end(),
+			[](const Entry &a, const Entry &b) { return a.Key < b.Key; });
+}
+
+void BroadPhase::Scroll(GLfloat road, GLfloat frames)
+{
+	for (Group &group : this->groups)
+		group.Offset += (road + group.Speed) * frames;
+}
+
+void BroadPhase::Insert(const std::vector<GameObject> &objects, GLuint index)
+{
+	const GameObject &object = objects[index];
+	Group &group = this->group(object.Velocity.y);
+	Entry entry = { object.Position.y - group.Offset, index };
+	// Spawns enter at the top of their group; one that doesn't (spawned lower than one before it) is sorted in
+	std::deque<Entry>::iterator position = group.Entries.begin();
+	if (!group.Entries.empty() && entry.Key > group.Entries.front().Key)
+		position = std::upper_bound(group.Entries.begin(), group.Entries.end(), entry,
+			[](const Entry &a, const Entry &b) { return a.Key < b.Key; });
+	// Keep the cursor on the same entry
+	if (static_cast<size_t>(position - group.Entries.begin()) <= group.Cursor)
+		++group.Cursor;
+	if (position == group.Entries.begin())
+		group.Entries.push_front(entry);
+	else
+		group.Entries.insert(position, entry);
+	this->tallest = std::max(this->tallest, object.Size.y);
+}
+
+void BroadPhase::Erase(const std::vector<GLuint> &numbers)
+{
+	for (Group &group : this->groups)
+	{
+		// Objects leave at the bottom of their group, so that is where the erased ones are
+		while (!group.Entries.empty() && numbers[group.Entries.back().Object] == BROAD_PHASE_ERASED)
+			group.Entries.pop_back();
+		// The others only need their new numbers (an erased one further up, as rounding may put it, is dropped too)
+		std::deque<Entry>::iterator kept = group.Entries.begin();
+		for (Entry &entry : group.Entries)
+		{
+			entry.Object = numbers[entry.Object];
+			if (entry.Object != BROAD_PHASE_ERASED)
+				*kept++ = entry;
+		}
+		group.Entries.erase(kept, group.Entries.end());
+	}
+}
+
+size_t BroadPhase::seek(const Group &group, GLdouble key)
+{
+	// Gallop from the cursor towards the key, doubling the stride, until it is bracketed by [low, high]
+	const std::deque<Entry> &entries = group.Entries;
+	size_t size = entries.size(), low = std::min(group.Cursor, size), high = low, step = 1;
+	if (low < size && entries[low].Key < key)
+	{
+		for (++low; low + step - 1 < size && entries[low + step - 1].Key < key; step *= 2)
+			low += step;
+		high = std::min(size, low + step - 1);
+	}
+	else
+	{
+		for (; high >= step && entries[high - step].Key >= key; step *= 2)
+			high -= step;
+		low = high >= step ? high - step + 1 : 0;
+	}
+	return std::lower_bound(entries.begin() + low, entries.begin() + high, key,
+		[](const Entry &entry, GLdouble k) { return entry.Key < k; }) - entries.begin();
+}
+
+void BroadPhase::Query(const std::vector<GameObject> &objects, const GameObject &area, std::vector<GLuint> &found) const
+{
+	found.clear();
+	// Nothing starting further above the area than the tallest object can reach down into it
+	GLfloat top = area.Position.y, bottom = area.Position.y + area.Size.y;
+	for (const Group &group : this->groups)
+	{
+		// Search the keys, then test where the candidates really are
+		GLdouble from = top - this->tallest - BROAD_PHASE_SLACK - group.Offset, to = bottom + BROAD_PHASE_SLACK - group.Offset;
+		group.Cursor = seek(group, from);
+		std::deque<Entry>::const_iterator first = group.Entries.begin() + group.Cursor;
+		for (std::deque<Entry>::const_iterator it = first; it != group.Entries.end() && it->Key <= to; ++it)
+		{
+			const GameObject &object = objects[it->Object];
+			if (object.Position.y <= bottom && object.Position.y + object.Size.y >= top)
+				found.push_back(it->Object);
+		}
+	}
+	// Callers handle the candidates in level order
+	std::sort(found.begin(), found.end());
+}
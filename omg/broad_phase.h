@@ -0,0 +1,76 @@
+/*******************************************************************
+** This code is part of Breakout.
+**
+** Breakout is free software: you can redistribute it and/or modify
+** it under the terms of the CC BY 4.0 license as published by
+** Creative Commons, either version 4 of the License, or (at your
+** option) any later version.
+******************************************************************/
+#ifndef BROAD_PHASE_H
+#define BROAD_PHASE_H
+#include <deque>
+#include <vector>
+
+#include "gl_types.h"
+#include "game_object.h"
+
+
+// How much (in pixels) queries are widened: an object's position picks up
+// rounding errors as it moves that the index's keys don't share
+const GLfloat BROAD_PHASE_SLACK = 1.0f;
+// Marks an object as erased in the numbering passed to BroadPhase::Erase
+const GLuint BROAD_PHASE_ERASED = 0xFFFFFFFF;
+
+// BroadPhase finds the objects that may collide with an area without
+// testing every object of a level (sort and sweep along y). It groups the
+// objects by vertical velocity, since every step moves all objects of a
+// group by the same amount (the road's scroll plus their own speed). A group
+// keeps, contiguous and sorted, each object's top edge when it was added
+// less how far the group had scrolled by then; scrolling only adds to the
+// group's offset, so moving never touches (or re-sorts) the keys. New
+// objects enter above the others of their speed and leave below them, so
+// adding one is a push at the front of its group and nothing is ever
+// re-sorted. A query searches every group's keys for the few objects whose
+// vertical extent overlaps the area, starting from where the group's last
+// query ended up: areas hardly move from one step to the next, so it only
+// passes the few keys that scrolled by since and takes about the same time
+// however long the level is.
+class BroadPhase
+{
+public:
+	// Constructor
+	BroadPhase();
+	// Indexes all objects from scratch (after they were loaded or changed vertical speed)
+	void Build(const std::vector<GameObject> &objects);
+	// Moves every group as far as the objects move in the given number of frames on a road scrolling by road per frame
+	void Scroll(GLfloat road, GLfloat frames);
+	// Adds objects[index], which was just spawned above (or level with) the others of its speed
+	void Insert(const std::vector<GameObject> &objects, GLuint index);
+	// Drops erased objects and renumbers the rest: numbers[i] is the new index of object i, or BROAD_PHASE_ERASED
+	void Erase(const std::vector<GLuint> &numbers);
+	// Collects the indices (ascending) of the objects whose vertical extent overlaps the area's
+	void Query(const std::vector<GameObject> &objects, const GameObject &area, std::vector<GLuint> &found) const;
+private:
+	// An object's top edge less its group's offset when it was added
+	struct Entry {
+		GLdouble Key;
+		GLuint   Object;
+	};
+	// Objects with the same vertical velocity, by key, how far they scrolled since the group was made
+	// and where the last query's first candidate was
+	struct Group {
+		GLfloat           Speed;
+		GLdouble          Offset;
+		std::deque<Entry> Entries;
+		mutable size_t    Cursor;
+	};
+	std::vector<Group> groups;
+	// Height of the tallest object, how far above an area a candidate can start
+	GLfloat tallest;
+	// The group of objects moving at speed, added if there is none yet
+	Group &group(GLfloat speed);
+	// Index of the first entry of group whose key isn't below key, found by galloping from its cursor
+	static size_t seek(const Group &group, GLdouble key);
+};
+
+#endif
@@ -1,104 +1,214 @@
 #include "car_level.h"
 
-#include <fstream>
-#include <sstream>
-#include <iostream>
+#include <algorithm>
+#include <limits>
 #include <time.h>
 
+#include "resource_name.h"
+
+#ifndef HEADLESS
+#include "sprite_renderer.h"
+#include "sprite_batch.h"
+#include "resource_manager.h"
+
+// Surfaces lie flat on the road and are drawn below every vehicle
+static GLboolean IsSurface(const GameObject &object)
+{
+	return object.code == vehicles::WATER || object.code == vehicles::BRIDGE || object.code == vehicles::ICE;
+}
+#endif
+
+// Size and sprite of each kind of vehicle
+static const glm::vec2 VEHICLE_SIZES[VEHICLE_COUNT] = {
+	glm::vec2(80, 160), glm::vec2(120, 120), glm::vec2(200, 200), glm::vec2(100, 100), glm::vec2(800, 600), glm::vec2(212, 600)
+};
+static constexpr ResourceName VEHICLE_SPRITES[VEHICLE_COUNT] = { "rcar", "deer", "ice", "star", "water", "bridge" };
+static constexpr ResourceName FINISH_SPRITE("finish");
+
+// Orders the pending heap: the vehicle due first is on top, and of those due at the same frame the first in the file
+static bool SpawnsLater(const Spawn &a, const Spawn &b)
+{
+	return a.Frame > b.Frame || (a.Frame == b.Frame && a.Order > b.Order);
+}
+
+// Sprite of a level object; the headless build only simulates, so it has no textures
+static Texture2D LevelSprite(ResourceName name)
+{
+#ifdef HEADLESS
+	(void)name;
+	return Texture2D();
+#else
+	return ResourceManager::GetTexture(name);
+#endif
+}
+
+CarLevel::CarLevel()
+	: fast(0.0f), read(0), readTime(0.0), frame(0.0), lead(0.0f), width(0), height(0)
+{
+
+}
+
 void CarLevel::Load(const GLchar *file, GLuint levelWidth, GLuint levelHeight, float velocity)
 {
 	this->fast = velocity;
+	this->width = levelWidth;
+	this->height = levelHeight;
+	this->read = 0;
+	this->readTime = 0.0;
+	this->frame = 0.0;
+	GLfloat tallest = 0.0f;
+	for (GLuint code = 0; code < VEHICLE_COUNT; ++code)
+	{
+		this->sprites[code] = LevelSprite(VEHICLE_SPRITES[code]);
+		tallest = std::max(tallest, VEHICLE_SIZES[code].y);
+	}
+	// The tallest vehicle driving no faster than the road (none is slower) comes into view the earliest before its time
+	this->lead = (tallest + SPAWN_MARGIN) / velocity + 60 * READ_AHEAD;
 	// Clear old data
 	this->cars.clear();
-	// Load from file
-	GLuint tileCode;
-	CarLevel level;
-	std::string line;
-	std::ifstream fstream(file);
-	float time;
-	int vehicle;
-	int position;
-	float speed;
-	if (fstream)
+	this->Index.Build(this->cars);
+	this->pending.clear();
+	this->last.Position = this->last.Velocity = glm::vec2(0.0f);
+	this->last.Frame = 0.0;
+	// The finish line is out of reach until the end of the level was read
+	glm::vec2 fsize = glm::vec2(levelWidth, levelHeight / 4);
+	this->finish = GameObject(glm::vec2(0.0f, -std::numeric_limits<GLfloat>::max()), fsize, LevelSprite(FINISH_SPRITE));
+	// Load from file, as far as it comes into view soon
+	this->reader = LevelReader::Open(file);
+	if (!this->reader)
+		this->placeFinish();
+	this->spawn();
+}
+
+void CarLevel::Advance(GLfloat frames)
+{
+	this->frame += frames;
+	// Move the traffic and the finish line down the road
+	for (GameObject &car : this->cars)
 	{
-		std::getline(fstream, line);	//First line is a throw away
-		while (std::getline(fstream, line)) // Read each line from level file
-		{
-			std::istringstream sstream(line);
-			sstream >> time >> vehicle >> position >> speed;
-			//std::cout << time << vehicle << position << speed << "\n";
-			if (vehicle == vehicles::CAR)	//Car
-			{
-				float placex = (position / 8.0)*levelWidth;
-				float placey = -60 * time*(velocity + speed);
-				glm::vec2 carPos = glm::vec2(placex, placey);
-				glm::vec2 carSize = glm::vec2(80, 160);
-				GameObject car(carPos, carSize, ResourceManager::GetTexture("rcar"), glm::vec3((float)rand() / RAND_MAX, (float)rand() / RAND_MAX, (float)rand() / RAND_MAX), glm::vec2(0, speed));
-				car.code = vehicles::CAR;
-				cars.push_back(car);
-			}
-			else if (vehicle == vehicles::DEER)	//Deer
-			{
-				float placex = -60*time*speed;
-				float placey = -60*time*velocity;
-				glm::vec2 carPos = glm::vec2(placex, placey);
-				glm::vec2 carSize = glm::vec2(120, 120);
-				GameObject car(carPos, carSize, ResourceManager::GetTexture("deer"), glm::vec3(1.0f), glm::vec2(speed, 0));
-				car.code = vehicles::DEER;
-				cars.push_back(car);
-				
-			}
-			else if (vehicle == vehicles::ICE)   //Ice
-			{
-				float placex = (position / 8.0)*levelWidth;
-				float placey = -60 * time*velocity;
-				glm::vec2 carPos = glm::vec2(placex, placey);
-				glm::vec2 carSize = glm::vec2(200, 200);
-				GameObject car(carPos, carSize, ResourceManager::GetTexture("ice"), glm::vec3(1.0f), glm::vec2(0, 0));
-				car.Destroyed = GL_TRUE;
-				car.code = vehicles::ICE;
-				cars.push_back(car);
-			}
-			else if (vehicle == vehicles::STAR)	//STAR
-			{
-				float placex = (position / 8.0)*levelWidth;
-				float placey = -60 * time*velocity;
-				glm::vec2 carPos = glm::vec2(placex, placey);
-				glm::vec2 carSize = glm::vec2(100, 100);
-				GameObject car(carPos, carSize, ResourceManager::GetTexture("star"), glm::vec3(1.0f), glm::vec2(0, 0));
-				car.code = vehicles::STAR;
-				cars.push_back(car);
-			}
-			else if (vehicle == vehicles::WATER)
-			{
-				float placex = 0;
-				float placey = -60 * time*velocity;
-				glm::vec2 carPos = glm::vec2(placex, placey);
-				glm::vec2 carSize = glm::vec2(800, 600);
-				GameObject car(carPos, carSize, ResourceManager::GetTexture("water"), glm::vec3(1.0f), glm::vec2(0, 0));
-				car.code = vehicles::WATER;
-				cars.push_back(car);
-			}
-			else if (vehicle == vehicles::BRIDGE)
-			{
-				float placey = -60 * time*velocity;
-				float placex = (position / 8.0)*levelWidth;
-				glm::vec2 carPos = glm::vec2(placex, placey);
-				glm::vec2 carSize = glm::vec2(212, 600);
-				GameObject car(carPos, carSize, ResourceManager::GetTexture("bridge"), glm::vec3(1.0f), glm::vec2(0, 0));
-				car.code = vehicles::BRIDGE;
-				cars.push_back(car);
-			}
+		car.Position.y += (this->fast + car.Velocity.y) * frames;
+		car.Position.x += car.Velocity.x * frames;
+	}
+	this->finish.Position.y += this->fast * frames;
+	this->Index.Scroll(this->fast, frames);
+	// Drop what scrolled past the bottom edge; erasing keeps the order, so a bridge stays right behind its water.
+	// The index drops them too and renumbers the rest, spawns are added to it as they come
+	GLfloat bottom = static_cast<GLfloat>(this->height);
+	GLuint count = 0;
+	this->numbers.resize(this->cars.size());
+	for (GLuint i = 0; i < this->cars.size(); ++i)
+	{
+		this->numbers[i] = this->cars[i].Position.y > bottom ? BROAD_PHASE_ERASED : count;
+		if (this->numbers[i] != BROAD_PHASE_ERASED)
+			this->cars[count++] = this->cars[i];
+	}
+	if (count != this->cars.size())
+	{
+		this->cars.erase(this->cars.begin() + count, this->cars.end());
+		this->Index.Erase(this->numbers);
+	}
+	this->spawn();
+}
 
+void CarLevel::readAhead()
+{
+	LevelRecord record;
+	// Nothing still in the file comes into view sooner than lead frames before the latest time read so far
+	while (this->reader && 60 * this->readTime - this->lead <= this->frame)
+	{
+		if (!this->reader->Next(record))
+		{
+			this->reader.reset();
+			this->placeFinish();
+			return;
 		}
-		GameObject lastCar = cars.back();
-		glm::vec2 fpos = glm::vec2(0, (lastCar.Position.y+(60*(lastCar.Velocity.y+velocity)))-(2*60*velocity));
-		glm::vec2 fsize = glm::vec2(levelWidth, levelHeight / 4);
-		finish = GameObject(fpos, fsize, ResourceManager::GetTexture("finish"));
-		
+		Spawn spawn;
+		if (!this->parse(record, spawn))
+			continue;
+		this->readTime = std::max(this->readTime, record.Time);
+		this->last = spawn;
+		this->pending.push_back(spawn);
+		std::push_heap(this->pending.begin(), this->pending.end(), SpawnsLater);
 	}
 }
 
+GLboolean CarLevel::parse(const LevelRecord &record, Spawn &spawn)
+{
+	GLdouble time = record.Time;
+	GLfloat speed = record.Speed, velocity = this->fast;
+	GLint vehicle = record.Vehicle, position = record.Position;
+	GLuint levelWidth = this->width;
+	spawn.Code = vehicle;
+	spawn.Order = this->read++;
+	spawn.Velocity = glm::vec2(0.0f);
+	spawn.Color = glm::vec3(1.0f);
+	// Where it would be at frame 0, far above the screen for vehicles late in a long level
+	GLdouble x, y;
+	if (vehicle == vehicles::CAR)	//Car
+	{
+		// A car slower than the road would come into view later than lead allows for (or never)
+		if (speed < 0.0f)
+			return GL_FALSE;
+		x = (position / 8.0)*levelWidth;
+		y = -60 * time*(velocity + speed);
+		spawn.Velocity = glm::vec2(0, speed);
+		spawn.Color = glm::vec3((float)rand() / RAND_MAX, (float)rand() / RAND_MAX, (float)rand() / RAND_MAX);
+	}
+	else if (vehicle == vehicles::DEER)	//Deer
+	{
+		x = -60 * time*speed;
+		y = -60 * time*velocity;
+		spawn.Velocity = glm::vec2(speed, 0);
+	}
+	else if (vehicle == vehicles::ICE || vehicle == vehicles::STAR || vehicle == vehicles::BRIDGE)
+	{
+		x = (position / 8.0)*levelWidth;
+		y = -60 * time*velocity;
+	}
+	else if (vehicle == vehicles::WATER)
+	{
+		x = 0;
+		y = -60 * time*velocity;
+	}
+	else
+		return GL_FALSE;
+	// Frame at which its bottom edge comes within SPAWN_MARGIN of the top of the screen, and where it is then
+	GLdouble bottom = y + VEHICLE_SIZES[vehicle].y;
+	spawn.Frame = std::max(0.0, (-SPAWN_MARGIN - bottom) / (velocity + spawn.Velocity.y));
+	spawn.Position = glm::vec2(x + spawn.Velocity.x * spawn.Frame, y + (velocity + spawn.Velocity.y) * spawn.Frame);
+	return GL_TRUE;
+}
+
+void CarLevel::placeFinish()
+{
+	const Spawn &lastCar = this->last;
+	// A second behind the last vehicle (as seen from frame 0), less two seconds of road
+	GLdouble y = lastCar.Position.y + (lastCar.Velocity.y + this->fast) * (60 - lastCar.Frame) - 2 * 60 * this->fast;
+	// It scrolled down with the road since frame 0 like everything else
+	y += this->fast * this->frame;
+	this->finish.Position = this->finish.PreviousPosition = glm::vec2(0.0f, y);
+}
+
+void CarLevel::spawn()
+{
+	this->readAhead();
+	while (!this->pending.empty() && this->pending.front().Frame <= this->frame)
+	{
+		std::pop_heap(this->pending.begin(), this->pending.end(), SpawnsLater);
+		// Put it where it would have driven to by now
+		const Spawn &spawn = this->pending.back();
+		glm::vec2 position = spawn.Position + (spawn.Velocity + glm::vec2(0.0f, this->fast)) * static_cast<GLfloat>(this->frame - spawn.Frame);
+		GameObject car(position, VEHICLE_SIZES[spawn.Code], this->sprites[spawn.Code], spawn.Color, spawn.Velocity);
+		car.code = spawn.Code;
+		// Ice is never hit, it only takes the steering away
+		car.Destroyed = spawn.Code == vehicles::ICE;
+		this->cars.push_back(car);
+		this->Index.Insert(this->cars, this->cars.size() - 1);
+		this->pending.pop_back();
+	}
+}
+
+#ifndef HEADLESS
 void CarLevel::Draw(SpriteRenderer &renderer)
 {
 	for (GameObject &car : this->cars)
@@ -109,6 +219,35 @@ void CarLevel::Draw(SpriteRenderer &renderer)
 	finish.Draw(renderer);
 }
 
+void CarLevel::Draw(SpriteBatch &batch, GLfloat alpha)
+{
+	// Road surfaces keep their level order so a bridge always covers the water below it
+	batch.Begin();
+	for (GameObject &car : this->cars)
+	{
+		if (IsSurface(car) && (!car.Destroyed || car.code == vehicles::ICE))
+			car.Draw(batch, alpha);
+	}
+	finish.Draw(batch, alpha);
+	batch.End();
+	// Vehicles are drawn on top of all surfaces and may be grouped by texture
+	batch.Begin(GL_TRUE);
+	for (GameObject &car : this->cars)
+	{
+		if (!IsSurface(car) && !car.Destroyed)
+			car.Draw(batch, alpha);
+	}
+	batch.End();
+}
+#endif
+
+void CarLevel::SavePositions()
+{
+	for (GameObject &car : this->cars)
+		car.PreviousPosition = car.Position;
+	finish.PreviousPosition = finish.Position;
+}
+
 GLboolean CarLevel::IsCompleted(int Height)
 {
 	if (this->finish.Position.y > Height)
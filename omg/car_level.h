@@ -3,34 +3,90 @@
 
 #include <vector>
 
-#include <GL/glew.h>
 #include <glm/glm.hpp>
 
+#include "gl_types.h"
 #include "game_object.h"
-#include "sprite_renderer.h"
-#include "resource_manager.h"
+#include "broad_phase.h"
+#include "level_reader.h"
 
 enum vehicles{
 	CAR, DEER, ICE, STAR, WATER, BRIDGE
 };
+const GLuint VEHICLE_COUNT = 6;
+
+// How far above the screen (in pixels) vehicles are spawned, so they never pop into view
+const GLfloat SPAWN_MARGIN = 100.0f;
+// Seconds a level file may be out of time order; records are read this much earlier than they are needed
+const GLfloat READ_AHEAD = 2.0f;
+
+// A vehicle of the level waiting to be spawned
+struct Spawn {
+	GLdouble  Frame;    // Frame (60th of a second of driving) at which it is about to scroll into view
+	GLint     Code;     // Kind of vehicle
+	glm::vec2 Position; // Where it is at Frame, just above the screen
+	glm::vec2 Velocity; // Movement per frame on top of the road's
+	glm::vec3 Color;
+	GLuint    Order;    // Position in the file, vehicles due at the same frame spawn in file order
+};
 
+// CarLevel streams the vehicles of a level from its file as the road scrolls
+// down. Records are read a short window ahead of the screen and wait in a
+// queue sorted by when they come into view; only the vehicles on screen (or
+// about to be) are spawned into cars, and once they scroll past the bottom
+// edge they are dropped again. Neither memory nor the work per step depend on
+// the level's length, so levels can be endless or gigabytes long.
 class CarLevel
 {
 public:
-	// Level state
+	// Level state: the vehicles on the road now, in the order they were spawned. The
+	// vector's storage is the pool they are spawned into, it stops growing once it
+	// holds the most vehicles that are ever on screen at once
 	std::vector<GameObject> cars;
 	GLfloat fast;
 	GameObject finish;
+	// Finds the cars near an area; vehicles are added to it as they spawn and dropped as they leave
+	BroadPhase Index;
 	// Constructor
-	CarLevel() { }
-	// Loads level from file
+	CarLevel();
+	// Loads level from file (reading only its start); a bridge must directly follow the water it crosses
 	void      Load(const GLchar *file, GLuint levelWidth, GLuint levelHeight, float velocity);
+	// Drives the given number of frames down the road: moves the vehicles, drops the ones that left the screen and spawns the ones about to enter it
+	void      Advance(GLfloat frames);
 	// Render level
 	void      Draw(SpriteRenderer &renderer);
+	// Render level with instanced draws (one per texture for the vehicles), alpha of the way through the last step
+	void      Draw(SpriteBatch &batch, GLfloat alpha = 1.0f);
+	// Remembers where everything is before a simulation step, to interpolate from
+	void      SavePositions();
 	// Check if the level is completed (all non-solid tiles are destroyed)
 	GLboolean IsCompleted(int Height);
 private:
-	// Initialize level from tile data
+	// Where the vehicles come from, and those read but not spawned yet (a heap, the next one due on top)
+	std::shared_ptr<LevelReader> reader;
+	std::vector<Spawn> pending;
+	// Records read so far, the latest time among them and the last one (the finish line follows it)
+	GLuint             read;
+	GLdouble           readTime;
+	Spawn              last;
+	// Frames driven so far (a double, so hours into a level steps still add up), and how many
+	// frames before its time a record may come into view
+	GLdouble           frame;
+	GLfloat            lead;
+	// Lanes are spread over the width; vehicles leave the level once they are below the height
+	GLuint             width, height;
+	// New index of each car while dropping those that left (reused every step)
+	std::vector<GLuint> numbers;
+	// Sprite of each kind of vehicle
+	Texture2D          sprites[VEHICLE_COUNT];
+	// Reads the records that may come into view before the road has driven lead frames further
+	void      readAhead();
+	// Turns a record into a vehicle to spawn; returns false for unknown vehicles
+	GLboolean parse(const LevelRecord &record, Spawn &spawn);
+	// Puts the finish line behind the last vehicle once the whole level was read
+	void      placeFinish();
+	// Spawns the vehicles that are about to come into view
+	void      spawn();
 };
 
 
@@ -0,0 +1,213 @@
+/*******************************************************************
+** This code is part of Breakout.
+**
+** Breakout is free software: you can redistribute it and/or modify
+** it under the terms of the CC BY 4.0 license as published by
+** Creative Commons, either version 4 of the License, or (at your
+** option) any later version.
+******************************************************************/
+#include "car_simulation.h"
+
+
+CarSimulation::CarSimulation(GLuint width, GLuint height)
+	: Player(glm::vec2(width / 2 - CAR_SIZE.x / 2, height - CAR_SIZE.y), CAR_SIZE, Texture2D(), CAR_COLOUR),
+	  Width(width), Height(height), Level(0), Lives(INITIAL_LIVES), InvincibleTime(0.0f), StopTime(0.0f), Sliding(GL_FALSE),
+	  RoadScroll(0.0f), PreviousRoadScroll(0.0f)
+{
+
+}
+
+void CarSimulation::AddLevel(const std::string &file, GLfloat velocity)
+{
+	this->files.push_back(file);
+	this->velocities.push_back(velocity);
+	this->Levels.push_back(CarLevel());
+}
+
+void CarSimulation::Start(GLuint level)
+{
+	for (GLuint i = 0; i < this->Levels.size(); ++i)
+		this->Levels[i].Load(this->files[i].c_str(), this->Width, this->Height, this->velocities[i]);
+	this->Level = level;
+	this->Lives = INITIAL_LIVES;
+	this->InvincibleTime = this->StopTime = 0.0f;
+	this->Sliding = GL_FALSE;
+	this->Player.Position = this->Player.PreviousPosition = glm::vec2(this->Width / 2 - CAR_SIZE.x / 2, this->Height - CAR_SIZE.y);
+	this->Player.Color = CAR_COLOUR;
+}
+
+void CarSimulation::Steer(glm::vec2 direction, GLfloat dt)
+{
+	if (!this->Steerable())
+		return;
+	// Each axis only moves if the car stays on screen
+	glm::vec2 position = this->Player.Position + direction * PLAYER_VELOCITY * dt;
+	if (position.x >= 0 && position.x <= this->Width - this->Player.Size.x)
+		this->Player.Position.x = position.x;
+	if (position.y >= 0 && position.y <= this->Height - this->Player.Size.y)
+		this->Player.Position.y = position.y;
+}
+
+void CarSimulation::Step(GLfloat dt, GLboolean playing)
+{
+	this->Events.clear();
+	// Nothing moves in between levels
+	if (this->StopTime > 0.0f)
+	{
+		this->StopTime -= dt;
+		return;
+	}
+	// Drive on, bringing in the traffic that comes into view
+	CarLevel &level = this->Current();
+	level.Advance(STEP_SCALE);
+	// Scroll the road along with the traffic, wrapping after a screen
+	this->RoadScroll += level.fast * STEP_SCALE;
+	if (this->RoadScroll >= this->Height)
+	{
+		this->RoadScroll -= this->Height;
+		this->PreviousRoadScroll -= this->Height;
+	}
+	// Check for collisions
+	this->doCollisions();
+	// Count down invincibility
+	if (this->InvincibleTime > 0.0f)
+	{
+		this->InvincibleTime -= dt;
+	}
+	else if (this->Player.Color != CAR_COLOUR)
+	{
+		this->Player.Color = CAR_COLOUR;
+		this->emit(EVENT_RECOVERED, this->Player);
+	}
+	// Check win condition
+	if (playing && this->Current().IsCompleted(this->Height))
+	{
+		if (this->Level < this->Levels.size() - 1)
+		{
+			this->Level += 1;
+			this->StopTime = LEVEL_PAUSE;
+			this->Sliding = GL_FALSE;
+			this->emit(EVENT_LEVEL_COMPLETE, this->Player);
+		}
+		else
+		{
+			this->emit(EVENT_WON, this->Player);
+		}
+	}
+}
+
+void CarSimulation::SavePositions()
+{
+	this->PreviousRoadScroll = this->RoadScroll;
+	this->Player.PreviousPosition = this->Player.Position;
+	this->Current().SavePositions();
+}
+
+GLboolean CarSimulation::Steerable() const
+{
+	return !this->Sliding && this->StopTime <= 0.0f;
+}
+
+CarLevel &CarSimulation::Current()
+{
+	return this->Levels[this->Level];
+}
+
+void CarSimulation::reload()
+{
+	this->Current().Load(this->files[this->Level].c_str(), this->Width, this->Height, this->velocities[this->Level]);
+	this->Sliding = GL_FALSE;
+}
+
+GLboolean CarSimulation::doCollisions()
+{
+	// Only the cars level with the player can touch it
+	std::vector<GameObject> &cars = this->Current().cars;
+	this->Current().Index.Query(cars, this->Player, this->nearby);
+	GLboolean onIce = GL_FALSE;
+	for (GLuint i : this->nearby)
+	{
+		GameObject &car = cars[i];
+		if (car.code == vehicles::ICE)
+		{
+			// Driving onto ice takes the steering away until the car is off it again
+			if (CheckCollision(this->Player, car))
+			{
+				onIce = GL_TRUE;
+				if (this->InvincibleTime <= 0.0f)
+					this->Sliding = GL_TRUE;
+			}
+		}
+		else if (car.code == vehicles::STAR && !car.Destroyed && CheckCollision(this->Player, car))
+		{
+			this->InvincibleTime = STAR_TIME;
+			this->Player.Color = CAR_COLOUR_I;
+			car.Destroyed = GL_TRUE;
+			this->emit(EVENT_STAR, car);
+		}
+		else if (car.code == vehicles::WATER && CheckCollision(this->Player, car) && this->InvincibleTime <= 0.0f)
+		{
+			// The water can only be crossed on the bridge that follows it in the level
+			if (i + 1 >= cars.size() || !CheckCollision(this->Player, cars[i + 1]))
+			{
+				this->emit(EVENT_SPLASH, this->Player);
+				if (!this->loseLife())
+					return GL_FALSE;
+			}
+		}
+		else if (car.code != vehicles::BRIDGE && !car.Destroyed && this->InvincibleTime <= 0.0f && CheckCollision(this->Player, car))
+		{
+			car.Destroyed = GL_TRUE;
+			this->emit(EVENT_CRASH, car);
+			if (!this->loseLife())
+				return GL_FALSE;
+		}
+	}
+	if (!onIce)
+		this->Sliding = GL_FALSE;
+	GameObject &finish = this->Current().finish;
+	if (!finish.Destroyed && CheckCollision(this->Player, finish))
+	{
+		finish.Destroyed = GL_TRUE;
+		this->Lives = INITIAL_LIVES;
+		this->emit(EVENT_FINISH, finish);
+	}
+	return GL_TRUE;
+}
+
+GLboolean CarSimulation::loseLife()
+{
+	this->Lives -= 1;
+	this->InvincibleTime = RECOVER_TIME;
+	this->Player.Color = CAR_COLOUR_I;
+	if (this->Lives == 0)
+	{
+		// Game over for this level, it starts over (the level was reloaded, so stop looking at it)
+		this->reload();
+		this->Lives = INITIAL_LIVES;
+		this->emit(EVENT_RESTART, this->Player);
+		return GL_FALSE;
+	}
+	return GL_TRUE;
+}
+
+void CarSimulation::emit(SimulationEventType type, const GameObject &object)
+{
+	SimulationEvent event;
+	event.Type = type;
+	event.Position = object.Position;
+	event.Size = object.Size;
+	this->Events.push_back(event);
+}
+
+GLboolean CheckCollision(const GameObject &one, const GameObject &two) // AABB - AABB collision
+{
+	// Collision x-axis?
+	GLboolean collisionX = one.Position.x + one.Size.x >= two.Position.x &&
+		two.Position.x + two.Size.x >= one.Position.x;
+	// Collision y-axis?
+	GLboolean collisionY = one.Position.y + one.Size.y >= two.Position.y &&
+		two.Position.y + two.Size.y >= one.Position.y;
+	// Collision only if on both axes
+	return collisionX && collisionY;
+}
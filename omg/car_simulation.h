@@ -0,0 +1,114 @@
+/*******************************************************************
+** This code is part of Breakout.
+**
+** Breakout is free software: you can redistribute it and/or modify
+** it under the terms of the CC BY 4.0 license as published by
+** Creative Commons, either version 4 of the License, or (at your
+** option) any later version.
+******************************************************************/
+#ifndef CAR_SIMULATION_H
+#define CAR_SIMULATION_H
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "gl_types.h"
+#include "game_object.h"
+#include "car_level.h"
+
+// Size and colours (normal and while invincible) of the player's car
+const glm::vec2 CAR_SIZE(50, 100);
+const glm::vec3 CAR_COLOUR(255.0 / 255.0, 187.0 / 255.0, 27.0 / 255.0);
+const glm::vec3 CAR_COLOUR_I(1 - (255.0 / 255.0), 1 - (187.0 / 255.0), 1 -(27.0 / 255.0));
+// Speed of the road of the first level (in pixels per 60th of a second)
+const float ROAD_VELOCITY = 5.0f;
+// Steering speed of the player (in pixels per second)
+const GLfloat PLAYER_VELOCITY(500.0f);
+// Lives at the start of a level, seconds of invincibility after picking up a star
+// or losing a life, and seconds the road stops between levels
+const GLuint  INITIAL_LIVES = 3;
+const GLfloat STAR_TIME = 8.0f;
+const GLfloat RECOVER_TIME = 1.5f;
+const GLfloat LEVEL_PAUSE = 1.5f;
+
+// Simulation steps per second (60, 120 or 240). The game always advances in
+// steps of SIMULATION_STEP seconds, however fast or slow it renders
+const GLuint  SIMULATION_RATE = 120;
+const GLfloat SIMULATION_STEP = 1.0f / SIMULATION_RATE;
+// Road, traffic and jump speeds are in pixels per 60th of a second; this scales them to one step
+const GLfloat STEP_SCALE = 60.0f / SIMULATION_RATE;
+
+// Things that happened during a step the game may want to show or play a sound for
+enum SimulationEventType {
+	EVENT_CRASH,          // Hit a vehicle (lost a life), Position/Size are the vehicle's
+	EVENT_SPLASH,         // Drove into the water (lost a life), Position/Size are the player's
+	EVENT_STAR,           // Picked up a star, Position/Size are the star's
+	EVENT_RECOVERED,      // Invincibility wore off
+	EVENT_FINISH,         // Crossed the finish line
+	EVENT_LEVEL_COMPLETE, // The finish line left the screen, the next level starts after a pause
+	EVENT_WON,            // Completed the last level
+	EVENT_RESTART         // Lost the last life, the level started over
+};
+
+struct SimulationEvent {
+	SimulationEventType Type;
+	glm::vec2           Position, Size;
+};
+
+// CarSimulation runs the car-dodging game: it drives down the levels (which
+// spawn their traffic as it comes into view), steers the player and resolves
+// collisions, lives and level completion. It needs no GL, window or
+// audio; everything the player should see or hear is reported through
+// Events, so it can run headless as fast as the CPU allows.
+class CarSimulation
+{
+public:
+	// Simulation state
+	std::vector<CarLevel>        Levels;
+	GameObject                   Player;
+	GLuint                       Width, Height;
+	GLuint                       Level, Lives;
+	// Seconds left of invincibility and of the pause between levels
+	GLfloat                      InvincibleTime, StopTime;
+	// Whether the player is sliding on ice (and can't steer)
+	GLboolean                    Sliding;
+	// How far the road has scrolled (in pixels, wrapping at the screen height) after the last step and before it
+	GLfloat                      RoadScroll, PreviousRoadScroll;
+	// What happened during the last step
+	std::vector<SimulationEvent> Events;
+	// Constructor
+	CarSimulation(GLuint width, GLuint height);
+	// Adds a level read from file whose road moves at velocity
+	void AddLevel(const std::string &file, GLfloat velocity);
+	// (Re)loads every level and starts playing the given one
+	void Start(GLuint level);
+	// Steers the player in direction (each axis -1 to 1) for dt seconds; does nothing while sliding or paused
+	void Steer(glm::vec2 direction, GLfloat dt);
+	// Advances one step of dt seconds; levels are only completed while playing (the menu lets the road go by)
+	void Step(GLfloat dt, GLboolean playing = GL_TRUE);
+	// Remembers where everything is before a step, to interpolate from when drawing
+	void SavePositions();
+	// Whether the player can be steered
+	GLboolean Steerable() const;
+	// The level being played
+	CarLevel &Current();
+private:
+	// Where each level is loaded from, and its road velocity
+	std::vector<std::string> files;
+	std::vector<GLfloat>     velocities;
+	// Cars near the player, found by the level's broad phase
+	std::vector<GLuint>      nearby;
+	// Reloads the current level from its file
+	void reload();
+	// Resolves collisions of the player with the level; returns false if the level restarted
+	GLboolean doCollisions();
+	// Takes a life after hitting something; returns false if that was the last one and the level restarted
+	GLboolean loseLife();
+	void emit(SimulationEventType type, const GameObject &object);
+};
+
+// AABB - AABB collision
+GLboolean CheckCollision(const GameObject &one, const GameObject &two);
+
+#endif
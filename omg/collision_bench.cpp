@@ -0,0 +1,114 @@
+/*******************************************************************
+** This code is part of Breakout.
+**
+** Breakout is free software: you can redistribute it and/or modify
+** it under the terms of the CC BY 4.0 license as published by
+** Creative Commons, either version 4 of the License, or (at your
+** option) any later version.
+******************************************************************/
+// Measures what finding the player's collisions costs per step on
+// synthetic levels of growing length, with the broad phase and by testing
+// every object like the game used to. The broad phase is only built once:
+// moving objects never have to be re-sorted, each step only scrolls the
+// index along with them (timed with the query). Built with -DHEADLESS (see the
+// Makefile). Usage: collision_bench [steps] [objects...]
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "car_simulation.h"
+#include "broad_phase.h"
+
+// Level sizes measured unless given on the command line
+const GLuint DEFAULT_SIZES[] = { 1000, 100000, 1000000 };
+const GLuint DEFAULT_STEPS = 1000;
+// Road the synthetic levels are laid out on, and how far apart (in pixels) their objects start
+const GLuint  ROAD_WIDTH = 800, ROAD_HEIGHT = 600;
+const GLfloat OBJECT_SPACING = 60.0f;
+
+typedef std::chrono::steady_clock Clock;
+
+// Nanoseconds since start
+static double since(Clock::time_point start)
+{
+	return std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+}
+
+// A level like the text levels, only longer: traffic in eight lanes at
+// different speeds, with the odd deer crossing, all above the screen
+static void makeLevel(CarLevel &level, GLuint count)
+{
+	level.cars.clear();
+	level.cars.reserve(count);
+	level.fast = ROAD_VELOCITY;
+	for (GLuint i = 0; i < count; ++i)
+	{
+		GameObject car;
+		car.Position = glm::vec2((rand() % 8) / 8.0f * ROAD_WIDTH, -OBJECT_SPACING * (i + 1));
+		if (rand() % 20 == 0)
+		{
+			car.Size = glm::vec2(120, 120);
+			car.Velocity = glm::vec2(static_cast<GLfloat>(rand() % 5), 0.0f);
+			car.code = vehicles::DEER;
+		}
+		else
+		{
+			car.Size = glm::vec2(80, 160);
+			car.Velocity = glm::vec2(0.0f, static_cast<GLfloat>(rand() % 4));
+			car.code = vehicles::CAR;
+		}
+		level.cars.push_back(car);
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	GLuint steps = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : DEFAULT_STEPS;
+	std::vector<GLuint> sizes;
+	for (int i = 2; i < argc; ++i)
+		sizes.push_back(std::strtoul(argv[i], nullptr, 10));
+	if (sizes.empty())
+		sizes.assign(DEFAULT_SIZES, DEFAULT_SIZES + sizeof(DEFAULT_SIZES) / sizeof(DEFAULT_SIZES[0]));
+
+	GameObject player(glm::vec2(ROAD_WIDTH / 2 - CAR_SIZE.x / 2, ROAD_HEIGHT - CAR_SIZE.y), CAR_SIZE, Texture2D());
+	std::printf("%10s %10s %18s %18s %10s\n", "objects", "build ms", "query ns/step", "all ns/step", "hits");
+	for (GLuint size : sizes)
+	{
+		srand(1);
+		CarLevel level;
+		makeLevel(level, size);
+		Clock::time_point start = Clock::now();
+		level.Index.Build(level.cars);
+		double build = since(start);
+
+		std::vector<GLuint> nearby;
+		double query = 0.0, all = 0.0;
+		unsigned long hits = 0, allHits = 0;
+		for (GLuint step = 0; step < steps; ++step)
+		{
+			// Move like CarSimulation::Step does (not measured, it's the same either way)
+			for (GameObject &car : level.cars)
+			{
+				car.Position.y += (level.fast + car.Velocity.y) * STEP_SCALE;
+				car.Position.x += car.Velocity.x * STEP_SCALE;
+			}
+			// Broad phase, then the exact test on what it found
+			start = Clock::now();
+			level.Index.Scroll(level.fast, STEP_SCALE);
+			level.Index.Query(level.cars, player, nearby);
+			for (GLuint i : nearby)
+				hits += CheckCollision(player, level.cars[i]);
+			query += since(start);
+			// Every object
+			start = Clock::now();
+			for (const GameObject &car : level.cars)
+				allHits += CheckCollision(player, car);
+			all += since(start);
+		}
+		if (hits != allHits)
+			std::printf("MISMATCH: the broad phase found %lu collisions, testing everything %lu\n", hits, allHits);
+		std::printf("%10u %10.2f %18.0f %18.0f %10lu\n", size, build / 1e6, query / steps, all / steps, hits);
+	}
+	return 0;
+}
@@ -7,6 +7,7 @@
 ** option) any later version.
 ******************************************************************/
 #include <algorithm>
+#include <chrono>
 #include <sstream>
 #include <iostream>
 #include <irrklang/irrKlang.h>
@@ -18,42 +19,86 @@ using namespace irrklang;
 #include "game.h"
 #include "resource_manager.h"
 #include "sprite_renderer.h"
+#include "sprite_batch.h"
 #include "game_object.h"
 #include "ball_object.h"
 #include "particle_generator.h"
 #include "post_processor.h"
+#include "quality_governor.h"
 #include "text_renderer.h"
 #include "mario.h"
 #include "car_level.h"
-
-
+#include "car_simulation.h"
+
+
+// Names of the shaders and textures, as constants so the compiler hashes them
+constexpr ResourceName SPRITE_SHADER("sprite");
+constexpr ResourceName SPRITE_BATCH_SHADER("sprite_batch");
+constexpr ResourceName PARTICLE_SHADER("particle");
+constexpr ResourceName PARTICLE_UPDATE_SHADER("particle_update");
+constexpr ResourceName BACKGROUND_TEXTURE("background");
+constexpr ResourceName ROAD_TEXTURE("road");
+constexpr ResourceName ROAD2_TEXTURE("road2");
+constexpr ResourceName BG2_TEXTURE("bg2");
+constexpr ResourceName FACE_TEXTURE("face");
+constexpr ResourceName BLOCK_TEXTURE("block");
+constexpr ResourceName BLOCK_SOLID_TEXTURE("block_solid");
+constexpr ResourceName PADDLE_TEXTURE("paddle");
+constexpr ResourceName PARTICLE_TEXTURE("particle");
+constexpr ResourceName POWERUP_SPEED_TEXTURE("powerup_speed");
+constexpr ResourceName POWERUP_STICKY_TEXTURE("powerup_sticky");
+constexpr ResourceName POWERUP_INCREASE_TEXTURE("powerup_increase");
+constexpr ResourceName POWERUP_CONFUSE_TEXTURE("powerup_confuse");
+constexpr ResourceName POWERUP_CHAOS_TEXTURE("powerup_chaos");
+constexpr ResourceName POWERUP_PASSTHROUGH_TEXTURE("powerup_passthrough");
+constexpr ResourceName MARIO_TEXTURE("mario");
+constexpr ResourceName CAR_TEXTURE("car");
+constexpr ResourceName RCAR_TEXTURE("rcar");
+constexpr ResourceName RCAR2_TEXTURE("rcar2");
+constexpr ResourceName FINISH_TEXTURE("finish");
+constexpr ResourceName WIN_TEXTURE("win");
+constexpr ResourceName FIREBALL_TEXTURE("fireball");
+constexpr ResourceName DEER_TEXTURE("deer");
+constexpr ResourceName STAR_TEXTURE("star");
+constexpr ResourceName ICE_TEXTURE("ice");
+constexpr ResourceName WATER_TEXTURE("water");
+constexpr ResourceName BRIDGE_TEXTURE("bridge");
 
 // Game-related State data
 SpriteRenderer    *Renderer;
+SpriteBatch       *Batch;
 GameObject        *Player;
+CarSimulation     *Simulation;
+// The player's car, owned by the simulation
 GameObject		  *Car;
 BallObject        *Ball;
 Mario			  *mario;
 ParticleGenerator *Particles;
 PostProcessor     *Effects;
+QualityGovernor   *Quality;
 ISoundEngine      *SoundEngine = createIrrKlangDevice();
 GLfloat            ShakeTime = 0.0f;
-GLfloat            stopTime = 0.0f;
 TextRenderer      *Text;
-CarLevel cl;
-std::vector<GLchar*> level_names;
-GLfloat            invincibleTime = 0.0f;
-GameObject* icePointer = nullptr;
+// Cached layouts of the HUD and overlay strings
+TextLayout        *LoadingText, *LivesText, *LevelText, *CompleteText;
+TextLayout        *StartText, *SelectText, *WonText, *RetryText;
 irrklang::ISound* mainTheme;
 irrklang::ISound* iTheme;
-
-// Collision detection
-GLboolean CheckCollision(GameObject &one, GameObject &two);
+std::chrono::steady_clock::time_point loadStart;
+// Textures drawn every frame, looked up by handle
+TextureHandle      BackgroundTexture, RoadTexture;
+
+// Particle effects
+void SpawnBurst(glm::vec2 position, glm::vec2 size, GLuint count, glm::vec3 color, GLfloat speed);
+// Shakes the screen for a moment (unless the quality tier skips cosmetic effects)
+void Shake();
+// Applies the governor's current quality tier
+void ApplyQuality();
 Collision CheckCollision(BallObject &one, GameObject &two);
 Direction VectorDirection(glm::vec2 closest);
 
 Game::Game(GLuint width, GLuint height)
-	: State(GAME_MENU), Keys(), Width(width), Height(height), Level(0), Lives(3)
+	: State(GAME_MENU), Keys(), Width(width), Height(height)
 {
 
 }
@@ -61,134 +106,171 @@ Game::Game(GLuint width, GLuint height)
 Game::~Game()
 {
 	delete Renderer;
+	delete Batch;
 	delete Player;
+	delete Simulation;
 	delete Ball;
 	delete Particles;
 	delete Effects;
+	delete Quality;
 	delete Text;
+	delete LoadingText;
+	delete LivesText;
+	delete LevelText;
+	delete CompleteText;
+	delete StartText;
+	delete SelectText;
+	delete WonText;
+	delete RetryText;
 	SoundEngine->drop();
 }
 
 void Game::Init()
 {
+	loadStart = std::chrono::steady_clock::now();
 	// Load shaders
-	ResourceManager::LoadShader("shaders/vertex.vs", "shaders/fragment.fs", nullptr, "sprite");
-	ResourceManager::LoadShader("shaders/particle.vs", "shaders/particle.fs", nullptr, "particle");
-	ResourceManager::LoadShader("shaders/post_processing.vs", "shaders/post_processing.fs", nullptr, "postprocessing");
+	ResourceManager::LoadShader("shaders/vertex.vs", "shaders/fragment.fs", nullptr, SPRITE_SHADER);
+	ResourceManager::LoadShader("shaders/sprite_batch.vs", "shaders/sprite_batch.fs", nullptr, SPRITE_BATCH_SHADER);
+	ResourceManager::LoadShader("shaders/particle.vs", "shaders/particle.fs", nullptr, PARTICLE_SHADER);
 	// Configure shaders
 	glm::mat4 projection = glm::ortho(0.0f, static_cast<GLfloat>(this->Width), static_cast<GLfloat>(this->Height), 0.0f, -1.0f, 1.0f);
-	ResourceManager::GetShader("sprite").Use().SetInteger("sprite", 0);
-	ResourceManager::GetShader("sprite").SetMatrix4("projection", projection);
-	ResourceManager::GetShader("particle").Use().SetInteger("sprite", 0);
-	ResourceManager::GetShader("particle").SetMatrix4("projection", projection);
-	// Load textures
-	ResourceManager::LoadTexture("textures/background.jpg", GL_FALSE, "background");
-	ResourceManager::LoadTexture("textures/road.jpg", GL_FALSE, "road");
-	ResourceManager::LoadTexture("textures/background.jpg", GL_FALSE, "road2");
-	ResourceManager::LoadTexture("textures/largebg.jpg", GL_FALSE, "bg2");
-	ResourceManager::LoadTexture("textures/awesomeface.png", GL_TRUE, "face");
-	ResourceManager::LoadTexture("textures/block.png", GL_FALSE, "block");
-	ResourceManager::LoadTexture("textures/block_solid.png", GL_FALSE, "block_solid");
-	ResourceManager::LoadTexture("textures/paddle.png", GL_TRUE, "paddle");
-	ResourceManager::LoadTexture("textures/particle.png", GL_TRUE, "particle");
-	ResourceManager::LoadTexture("textures/powerup_speed.png", GL_TRUE, "powerup_speed");
-	ResourceManager::LoadTexture("textures/powerup_sticky.png", GL_TRUE, "powerup_sticky");
-	ResourceManager::LoadTexture("textures/powerup_increase.png", GL_TRUE, "powerup_increase");
-	ResourceManager::LoadTexture("textures/powerup_confuse.png", GL_TRUE, "powerup_confuse");
-	ResourceManager::LoadTexture("textures/powerup_chaos.png", GL_TRUE, "powerup_chaos");
-	ResourceManager::LoadTexture("textures/powerup_passthrough.png", GL_TRUE, "powerup_passthrough");
-	ResourceManager::LoadTexture("textures/mario.png", GL_TRUE, "mario");
-	ResourceManager::LoadTexture("textures/car.png", GL_TRUE, "car");
-	ResourceManager::LoadTexture("textures/rcar.png", GL_TRUE, "rcar");
-	ResourceManager::LoadTexture("textures/rcar2.png", GL_TRUE, "rcar2");
-	ResourceManager::LoadTexture("textures/finish.jpg", GL_TRUE, "finish");
-	ResourceManager::LoadTexture("textures/win.png", GL_TRUE, "win");
-	ResourceManager::LoadTexture("textures/fireball.png", GL_TRUE, "fireball");
-	ResourceManager::LoadTexture("textures/deer.png", GL_TRUE, "deer");
-	ResourceManager::LoadTexture("textures/star.png", GL_TRUE, "star");
-	ResourceManager::LoadTexture("textures/ice.png", GL_TRUE, "ice");
-	ResourceManager::LoadTexture("textures/water.png", GL_TRUE, "water");
-	ResourceManager::LoadTexture("textures/board.png", GL_TRUE, "bridge");
-
+	ResourceManager::SetProjection(projection);
+	ResourceManager::GetShader(SPRITE_SHADER).Use().SetInteger("sprite", 0);
+	ResourceManager::GetShader(SPRITE_BATCH_SHADER).Use().SetInteger("image", 0);
+	ResourceManager::GetShader(PARTICLE_SHADER).Use().SetInteger("sprite", 0);
+	// Load textures; they are decoded in the background while the loading screen shows
+	BackgroundTexture = ResourceManager::QueueTexture("textures/background.jpg", GL_FALSE, BACKGROUND_TEXTURE);
+	RoadTexture = ResourceManager::QueueTexture("textures/road.jpg", GL_FALSE, ROAD_TEXTURE);
+	ResourceManager::QueueTexture("textures/background.jpg", GL_FALSE, ROAD2_TEXTURE);
+	ResourceManager::QueueTexture("textures/largebg.jpg", GL_FALSE, BG2_TEXTURE);
+	// Sprites share a few atlas pages so whole layers draw with one texture bind
+	ResourceManager::AddToAtlas("textures/awesomeface.png", GL_TRUE, FACE_TEXTURE);
+	ResourceManager::AddToAtlas("textures/block.png", GL_FALSE, BLOCK_TEXTURE);
+	ResourceManager::AddToAtlas("textures/block_solid.png", GL_FALSE, BLOCK_SOLID_TEXTURE);
+	ResourceManager::AddToAtlas("textures/paddle.png", GL_TRUE, PADDLE_TEXTURE);
+	ResourceManager::AddToAtlas("textures/particle.png", GL_TRUE, PARTICLE_TEXTURE);
+	ResourceManager::AddToAtlas("textures/powerup_speed.png", GL_TRUE, POWERUP_SPEED_TEXTURE);
+	ResourceManager::AddToAtlas("textures/powerup_sticky.png", GL_TRUE, POWERUP_STICKY_TEXTURE);
+	ResourceManager::AddToAtlas("textures/powerup_increase.png", GL_TRUE, POWERUP_INCREASE_TEXTURE);
+	ResourceManager::AddToAtlas("textures/powerup_confuse.png", GL_TRUE, POWERUP_CONFUSE_TEXTURE);
+	ResourceManager::AddToAtlas("textures/powerup_chaos.png", GL_TRUE, POWERUP_CHAOS_TEXTURE);
+	ResourceManager::AddToAtlas("textures/powerup_passthrough.png", GL_TRUE, POWERUP_PASSTHROUGH_TEXTURE);
+	ResourceManager::AddToAtlas("textures/mario.png", GL_TRUE, MARIO_TEXTURE);
+	ResourceManager::AddToAtlas("textures/car.png", GL_TRUE, CAR_TEXTURE);
+	ResourceManager::AddToAtlas("textures/rcar.png", GL_TRUE, RCAR_TEXTURE);
+	ResourceManager::AddToAtlas("textures/rcar2.png", GL_TRUE, RCAR2_TEXTURE);
+	ResourceManager::AddToAtlas("textures/finish.jpg", GL_TRUE, FINISH_TEXTURE);
+	ResourceManager::AddToAtlas("textures/win.png", GL_TRUE, WIN_TEXTURE);
+	ResourceManager::AddToAtlas("textures/fireball.png", GL_TRUE, FIREBALL_TEXTURE);
+	ResourceManager::AddToAtlas("textures/deer.png", GL_TRUE, DEER_TEXTURE);
+	ResourceManager::AddToAtlas("textures/star.png", GL_TRUE, STAR_TEXTURE);
+	ResourceManager::AddToAtlas("textures/ice.png", GL_TRUE, ICE_TEXTURE);
+	ResourceManager::AddToAtlas("textures/water.png", GL_TRUE, WATER_TEXTURE);
+	ResourceManager::AddToAtlas("textures/board.png", GL_TRUE, BRIDGE_TEXTURE);
+	ResourceManager::StartLoadingTextures();
+	// Set render-specific controls (the loading screen already needs the text renderer)
+	Renderer = new SpriteRenderer(ResourceManager::GetShader(SPRITE_SHADER));
+	Batch = new SpriteBatch(ResourceManager::GetShader(SPRITE_BATCH_SHADER));
+	Text = new TextRenderer();
+	Text->Load("fonts/OCRAEXT.TTF", 24);
+	LoadingText = new TextLayout(300.0f, this->Height / 2, 1.0f);
+	LivesText = new TextLayout(5.0f, 5.0f, 1.0f);
+	LevelText = new TextLayout(this->Width - 125.0f, 5.0f, 1.0f);
+	CompleteText = new TextLayout(200.0f, this->Height / 2, 2.0f);
+	CompleteText->SetText("LEVEL COMPLETE!");
+	StartText = new TextLayout(250.0f, this->Height / 2, 1.0f);
+	StartText->SetText("Press ENTER to start");
+	SelectText = new TextLayout(245.0f, this->Height / 2 + 20.0f, 0.75f);
+	SelectText->SetText("Press W or S to select level");
+	WonText = new TextLayout(320.0f, this->Height / 2 - 20.0f, 1.0f, glm::vec3(0.0f, 1.0f, 0.0f));
+	WonText->SetText("You WON!!!");
+	RetryText = new TextLayout(130.0f, this->Height / 2, 1.0f, glm::vec3(1.0f, 1.0f, 0.0f));
+	RetryText->SetText("Press ENTER to retry or ESC to quit");
+	// Everything else is set up by FinishInit once the textures are in
+	this->State = GAME_LOADING;
+	std::chrono::duration<double, std::milli> initTime = std::chrono::steady_clock::now() - loadStart;
+	std::cout << "Started in " << initTime.count() << " ms (" << ResourceManager::ShaderCacheHits << " cached programs, "
+		<< ResourceManager::ShaderCacheMisses << " compiled), loading textures in the background" << std::endl;
+}
 
+void Game::FinishInit()
+{
+	std::chrono::duration<double, std::milli> loadTime = std::chrono::steady_clock::now() - loadStart;
+	std::cout << "Loaded textures in " << loadTime.count() << " ms (" << ResourceManager::BakedTextures << " baked, "
+		<< ResourceManager::DecodedTextures << " decoded)" << std::endl;
 	// Set render-specific controls
-	Renderer = new SpriteRenderer(ResourceManager::GetShader("sprite"));
-	Particles = new ParticleGenerator(ResourceManager::GetShader("particle"), ResourceManager::GetTexture("fireball"), 500);
-	Effects = new PostProcessor(ResourceManager::GetShader("postprocessing"), this->Width, this->Height);
-	Text = new TextRenderer(this->Width, this->Height);
-	Text->Load("fonts/OCRAEXT.TTF", 24);
+	if (PARTICLES_ON_GPU)
+	{
+		const GLchar *varyings[] = { "outPosition", "outVelocity", "outColor", "outLife" };
+		ResourceManager::LoadFeedbackShader("shaders/particle_update.vs", varyings, 4, PARTICLE_UPDATE_SHADER);
+		Particles = new ParticleGenerator(ResourceManager::GetShader(PARTICLE_SHADER), ResourceManager::GetShader(PARTICLE_UPDATE_SHADER), ResourceManager::GetTexture(FIREBALL_TEXTURE), PARTICLE_POOL_SIZE);
+	}
+	else
+		Particles = new ParticleGenerator(ResourceManager::GetShader(PARTICLE_SHADER), ResourceManager::GetTexture(FIREBALL_TEXTURE), PARTICLE_POOL_SIZE);
+	Particles->ViewMax = glm::vec2(this->Width, this->Height);
+	// Start at the best quality and let the governor step down if frames take too long
+	Quality = new QualityGovernor(TARGET_FRAME_TIME);
+	Effects = new PostProcessor(this->Width, this->Height, Quality->Current().Samples);
+	ApplyQuality();
 	// Load levels
 	GameLevel one; one.Load("levels/one.lvl", this->Width, this->Height * 0.5);
 	GameLevel two; two.Load("levels/two.lvl", this->Width, this->Height * 0.5);
 	GameLevel three; three.Load("levels/three.lvl", this->Width, this->Height * 0.5);
 	GameLevel four; four.Load("levels/four.lvl", this->Width, this->Height * 0.5);
-	
-	cl.Load("levels/one.txt", this->Width, this->Height, ROAD_VELOCITY);
-	CarLevel lv1;
-	CarLevel lv2;
-	CarLevel lv3;
-	CarLevels2.push_back(lv1);
-	CarLevels2.push_back(lv2);
-	CarLevels2.push_back(lv3);
-	CarLevels2.at(0).Load("levels/1.txt", this->Width, this->Height, ROAD_VELOCITY);
-	CarLevels2.at(1).Load("levels/2.txt", this->Width, this->Height, ROAD_VELOCITY + 2.5f);
-	CarLevels2.at(2).Load("levels/3.txt", this->Width, this->Height, ROAD_VELOCITY + 5.0f);
-	level_names.push_back("levels/1.txt");
-	level_names.push_back("levels/2.txt");
-	level_names.push_back("levels/3.txt");
-	CarLevels.push_back(&cl);
 	this->Levels.push_back(one);
 	this->Levels.push_back(two);
 	this->Levels.push_back(three);
 	this->Levels.push_back(four);
-	this->Level = 0;
+	// The car game's levels get faster as they go
+	Simulation = new CarSimulation(this->Width, this->Height);
+	Simulation->AddLevel("levels/1.txt", ROAD_VELOCITY);
+	Simulation->AddLevel("levels/2.txt", ROAD_VELOCITY + 2.5f);
+	Simulation->AddLevel("levels/3.txt", ROAD_VELOCITY + 5.0f);
+	Simulation->Start(0);
 	// Configure game objects
 	glm::vec2 playerPos = glm::vec2(this->Width / 2 - PLAYER_SIZE.x / 2, this->Height - PLAYER_SIZE.y);
-	glm::vec2 carPos = glm::vec2(this->Width / 2 - CAR_SIZE.x / 2, this->Height - CAR_SIZE.y);
-	Player = new GameObject(playerPos, PLAYER_SIZE, ResourceManager::GetTexture("paddle"));
-	Car = new GameObject(carPos, CAR_SIZE, ResourceManager::GetTexture("rcar2"),CAR_COLOUR);
+	Player = new GameObject(playerPos, PLAYER_SIZE, ResourceManager::GetTexture(PADDLE_TEXTURE));
+	Car = &Simulation->Player;
+	Car->Sprite = ResourceManager::GetTexture(RCAR2_TEXTURE);
 	glm::vec2 ballPos = playerPos + glm::vec2(PLAYER_SIZE.x / 2 - BALL_RADIUS, -BALL_RADIUS * 2);
-	Ball = new BallObject(ballPos, BALL_RADIUS, INITIAL_BALL_VELOCITY, ResourceManager::GetTexture("face"));
+	Ball = new BallObject(ballPos, BALL_RADIUS, INITIAL_BALL_VELOCITY, ResourceManager::GetTexture(FACE_TEXTURE));
 
 	glm::vec2 marioPos = glm::vec2(this->Width / 2 - MARIO_SIZE.x / 2, this->Height - MARIO_SIZE.y);
-	mario = new Mario(marioPos, MARIO_SIZE, INITIAL_MARIO_VELOCITY, ResourceManager::GetTexture("mario"));
+	mario = new Mario(marioPos, MARIO_SIZE, INITIAL_MARIO_VELOCITY, ResourceManager::GetTexture(MARIO_TEXTURE));
 	// Audio
 	mainTheme = SoundEngine->play2D("audio/cuphead.mp3", GL_TRUE, GL_FALSE, GL_TRUE);
-
-	int k = 2;
-
-
-
-	for (GameObject &car : CarLevels2.at(this->Level).cars)
-	{
-		std::cout << "code: " << car.code << std::endl;
-	}
-
-
-
-
-
-
 }
 
 void Game::Update(GLfloat dt)
 {
-	if (stopTime <= 0) {
+	// Keep uploading textures until all are in, then start playing (like the game did before there was a loading screen)
+	if (this->State == GAME_LOADING)
+	{
+		if (ResourceManager::UpdateLoading(LOADING_BUDGET))
+		{
+			this->FinishInit();
+			this->State = GAME_ACTIVE;
+		}
+		return;
+	}
+	// Traffic, collisions, lives and level progress; then show and play what happened
+	GLboolean paused = Simulation->StopTime > 0.0f;
+	Simulation->Step(dt, this->State == GAME_ACTIVE);
+	this->HandleEvents();
+	if (!paused)
+	{
 		// Update objects
-		//std::cout << "IN UPDATE\n";
 		Ball->Move(dt, this->Width);
-		mario->update_jump(dt, MARIO_JUMP_TIME, MARIO_JUMP_VELOCITY);
-
-		for (GameObject &car : CarLevels2.at(this->Level).cars)
+		mario->update_jump(dt, MARIO_JUMP_TIME, MARIO_JUMP_VELOCITY * STEP_SCALE);
+		// Update particles, every car on the road leaves an exhaust trail
+		Particles->Focus = Car->Position + CAR_SIZE * 0.5f;
+		Particles->Emit(ParticleEmitter(Car->Position + glm::vec2(10, CAR_SIZE.y - 10), PLAYER_EXHAUST_RATE));
+		for (GameObject &car : Simulation->Current().cars)
 		{
-			car.Position.y += CarLevels2.at(this->Level).fast + car.Velocity.y;
-			car.Position.x += car.Velocity.x;
+			if (car.code == vehicles::CAR && !car.Destroyed)
+				Particles->Emit(ParticleEmitter(car.Position + glm::vec2(car.Size.x * 0.2f, car.Size.y - 10), TRAFFIC_EXHAUST_RATE));
 		}
-		CarLevels2.at(this->Level).finish.Position.y += CarLevels2.at(this->Level).fast;
-		// Check for collisions
-		this->DoCollisions();
-		// Update particles
-		Particles->Update(dt, *Car, 2, glm::vec2(10, CAR_SIZE.y - 10));
+		Particles->Update(dt);
 		// Update PowerUps
 		this->UpdatePowerUps(dt);
 		// Reduce shake time
@@ -201,59 +283,26 @@ void Game::Update(GLfloat dt)
 				//mainTheme->setIsPaused(GL_FALSE);
 			}
 		}
-		if (invincibleTime > 0.0f)
-		{
-			invincibleTime -= dt;
-		}
-		else if (invincibleTime <= 0.0f && Car->Color != CAR_COLOUR)
-		{
-			Car->Color = CAR_COLOUR;
-			mainTheme->setIsPaused(GL_FALSE);
-			if (iTheme) iTheme->stop();
-		}
-
-		if (icePointer != nullptr)
-		{
-			if (!CheckCollision(*Car, *icePointer))
-			{
-				icePointer = nullptr;
-			}
-		}
 		// Check loss condition
 		if (Ball->Position.y >= this->Height) // Did ball reach bottom edge?
 		{
-			--this->Lives;
+			--Simulation->Lives;
 			// Did the player lose all his lives? : Game over
-			if (this->Lives == 0)
+			if (Simulation->Lives == 0)
 			{
 				this->ResetLevel();
 				this->State = GAME_MENU;
 			}
 			this->ResetPlayer();
 		}
-		// Check win condition
-		if (this->State == GAME_ACTIVE && CarLevels2.at(this->Level).IsCompleted(this->Height))
-		{
-			if (this->Level < CarLevels2.size() - 1)
-			{
-				this->Level += 1;
-				stopTime = 1.5f;
-			}
-			else
-			{
-				this->State = GAME_WIN;
-			}
-		}
-	}
-	else
-	{
-		stopTime -= dt;
 	}
 }
 
 
 void Game::ProcessInput(GLfloat dt)
 {
+	if (this->State == GAME_LOADING)
+		return;
 	if (this->State == GAME_MENU)
 	{
 		if (this->Keys[GLFW_KEY_ENTER] && !this->KeysProcessed[GLFW_KEY_ENTER])
@@ -263,15 +312,15 @@ void Game::ProcessInput(GLfloat dt)
 		}
 		if (this->Keys[GLFW_KEY_W] && !this->KeysProcessed[GLFW_KEY_W])
 		{
-			this->Level = (this->Level + 1) % 4;
+			Simulation->Level = (Simulation->Level + 1) % Simulation->Levels.size();
 			this->KeysProcessed[GLFW_KEY_W] = GL_TRUE;
 		}
 		if (this->Keys[GLFW_KEY_S] && !this->KeysProcessed[GLFW_KEY_S])
 		{
-			if (this->Level > 0)
-				--this->Level;
+			if (Simulation->Level > 0)
+				--Simulation->Level;
 			else
-				this->Level = 3;
+				Simulation->Level = Simulation->Levels.size() - 1;
 			this->KeysProcessed[GLFW_KEY_S] = GL_TRUE;
 		}
 	}
@@ -282,22 +331,20 @@ void Game::ProcessInput(GLfloat dt)
 			this->KeysProcessed[GLFW_KEY_ENTER] = GL_TRUE;
 			Effects->Chaos = GL_FALSE;
 			this->State = GAME_ACTIVE;
-			CarLevels2.at(0).Load("levels/one.txt", this->Width, this->Height, ROAD_VELOCITY);
-			CarLevels2.at(1).Load("levels/two.txt", this->Width, this->Height, ROAD_VELOCITY + 2.5f);
-			CarLevels2.at(2).Load("levels/one.txt", this->Width, this->Height, ROAD_VELOCITY + 5.0f);
-			this->Level = 0;
+			Simulation->Start(0);
 		}
 	}
-	if (this->State == GAME_ACTIVE && icePointer == nullptr && stopTime <= 0)
+	if (this->State == GAME_ACTIVE && Simulation->Steerable())
 	{
 		GLfloat velocity = PLAYER_VELOCITY * dt;
-		// Move playerboard
+		// Move playerboard; the car is steered through the simulation, like with the gamepad
+		glm::vec2 steer(0.0f);
 		if (this->Keys[GLFW_KEY_A])
 		{
+			steer.x -= 1.0f;
 			if (Car->Position.x >= 0)
 			{
 				Player->Position.x -= velocity;
-				Car->Position.x -= velocity;
 				mario->Position.x -= velocity+1;
 				if (Ball->Stuck)
 					Ball->Position.x -= velocity;
@@ -305,31 +352,19 @@ void Game::ProcessInput(GLfloat dt)
 		}
 		if (this->Keys[GLFW_KEY_D])
 		{
+			steer.x += 1.0f;
 			if (Car->Position.x <= this->Width - Car->Size.x)
 			{
 				Player->Position.x += velocity;
 				mario->Position.x += velocity + 1;
-				Car->Position.x += velocity;
 				if (Ball->Stuck)
 					Ball->Position.x += velocity;
 			}
 		}
 		if (this->Keys[GLFW_KEY_S])
-		{
-			if (Car->Position.y <= this->Height - Car->Size.y)
-			{
-				
-				Car->Position.y += velocity;
-				
-			}
-		}
+			steer.y += 1.0f;
 		if (this->Keys[GLFW_KEY_W])
-		{
-			if (Car->Position.y >= 0)
-			{
-				Car->Position.y -= velocity;
-			}
-		}
+			steer.y -= 1.0f;
 		if (this->Keys[GLFW_KEY_SPACE])
 		{
 			Ball->Stuck = GL_FALSE;
@@ -350,61 +385,57 @@ void Game::ProcessInput(GLfloat dt)
 		float leftStickX = (abs(normLX) < deadzoneX ? 0 : normLX);
 		float leftStickY = (abs(normLY) < deadzoneY ? 0 : normLY);
 
-		float yy = Car->Position.y - velocity*leftStickY;
-		float xx = Car->Position.x + velocity*leftStickX;
-
-		if (xx >= 0 && xx <= this->Width - Car->Size.x)
-		{
-			Car->Position.x = xx;
-		}
-		if (yy >= 0 && yy <= this->Height - Car->Size.y)
-		{
-			Car->Position.y = yy;
-		}
+		// Keys and stick add up, to at most full speed on each axis
+		Simulation->Steer(glm::clamp(steer + glm::vec2(leftStickX, -leftStickY), -1.0f, 1.0f), dt);
 	}
 }
 
-float bgpos = 0;
-float gooby = ROAD_VELOCITY;
-void Game::Render()
+void Game::SaveState()
 {
+	if (this->State == GAME_LOADING)
+		return;
+	// Everything that moves remembers where it was, so Render can interpolate between steps
+	Simulation->SavePositions();
+	for (PowerUp &powerUp : this->PowerUps)
+		powerUp.PreviousPosition = powerUp.Position;
+}
+
+void Game::Render(GLfloat alpha)
+{
+	if (this->State == GAME_LOADING)
+	{
+		LoadingText->SetText("Loading... ", static_cast<GLint>(ResourceManager::LoadingProgress() * 100.0f), "%");
+		Text->RenderText(*LoadingText);
+		return;
+	}
+	Quality->BeginFrame();
 	if (this->State == GAME_ACTIVE || this->State == GAME_MENU || this->State == GAME_WIN)
 	{
 		// Begin rendering to postprocessing quad
 		Effects->BeginRender();
-		// Draw background
-		bgpos -= 1;
-		//std::cout << "Position: " << bgpos << "Height: " << this->Height << std::endl;
-		float test = (-(float)this->Height)/ CarLevels2.at(this->Level).fast;
-		if (bgpos == test)
-		{
-			bgpos = 0;
-		}
-		bgpos = (float)((int) bgpos);
-		float lastgoob = gooby;
-		gooby = CarLevels2.at(this->Level).fast;
-		if (stopTime > 0)
-		{
-			gooby = 0;
-		}
-		
-		//float gooby = CarLevels2.at(this->Level).fast;
-		Renderer->DrawSprite(ResourceManager::GetTexture("background"), glm::vec2(40, 0), glm::vec2(this->Width, this->Height), 0.0f);
-		Renderer->DrawSprite(ResourceManager::GetTexture("road"), glm::vec2(0, (0-bgpos)*gooby), glm::vec2(this->Width, this->Height), 0.0f);
-		Renderer->DrawSprite(ResourceManager::GetTexture("road"), glm::vec2(0, ((0 - bgpos)*gooby)- this->Height), glm::vec2(this->Width, this->Height), 0.0f);
+		// Draw background; the road is drawn twice so it wraps around seamlessly
+		GLfloat roadScroll = glm::mix(Simulation->PreviousRoadScroll, Simulation->RoadScroll, alpha);
+		Batch->ResetStats();
+		Batch->Begin();
+		Batch->DrawSprite(ResourceManager::GetTexture(BackgroundTexture), glm::vec2(40, 0), glm::vec2(this->Width, this->Height), 0.0f);
+		Batch->DrawSprite(ResourceManager::GetTexture(RoadTexture), glm::vec2(0, roadScroll), glm::vec2(this->Width, this->Height), 0.0f);
+		Batch->DrawSprite(ResourceManager::GetTexture(RoadTexture), glm::vec2(0, roadScroll - this->Height), glm::vec2(this->Width, this->Height), 0.0f);
+		Batch->End();
 		// Draw level
 		//this->Levels[this->Level].Draw(*Renderer);
 		// Draw player
 		//Player->Draw(*Renderer);
 		
-		CarLevels2.at(this->Level).Draw(*Renderer);
+		Simulation->Current().Draw(*Batch, alpha);
 		// Draw particles	
 		Particles->Draw();
-		Car->Draw(*Renderer);
+		Batch->Begin();
+		Car->Draw(*Batch, alpha);
 		// Draw PowerUps
 		for (PowerUp &powerUp : this->PowerUps)
 			if (!powerUp.Destroyed)
-				powerUp.Draw(*Renderer);
+				powerUp.Draw(*Batch, alpha);
+		Batch->End();
 		
 		// Draw ball
 		//Ball->Draw(*Renderer);
@@ -412,40 +443,42 @@ void Game::Render()
 		Effects->EndRender();
 		// Render postprocessing quad
 		Effects->Render(glfwGetTime());
-		// Render text (don't include in postprocessing)
-		std::stringstream ss; ss << this->Lives;
-		std::stringstream ss2; ss2 << (this->Level + 1);
-		Text->RenderText("Lives:" + ss.str(), 5.0f, 5.0f, 1.0f);
-		Text->RenderText("Level: " + ss2.str(), this->Width - 125.0f, 5.0f, 1.0f);
+		// Render text (don't include in postprocessing); layouts are only rebuilt when the numbers change
+		LivesText->SetText("Lives:", Simulation->Lives);
+		LevelText->SetText("Level: ", Simulation->Level + 1);
+		Text->RenderText(*LivesText);
+		Text->RenderText(*LevelText);
 	}
-	if (stopTime > 0)
+	if (Simulation->StopTime > 0)
 	{
-		Text->RenderText("LEVEL COMPLETE!", 200.0f, this->Height / 2, 2.0f);
+		Text->RenderText(*CompleteText);
 	}
 	if (this->State == GAME_MENU)
 	{
-		Text->RenderText("Press ENTER to start", 250.0f, this->Height / 2, 1.0f);
-		Text->RenderText("Press W or S to select level", 245.0f, this->Height / 2 + 20.0f, 0.75f);
+		Text->RenderText(*StartText);
+		Text->RenderText(*SelectText);
 	}
 	if (this->State == GAME_WIN)
 	{
-		Text->RenderText("You WON!!!", 320.0f, this->Height / 2 - 20.0f, 1.0f, glm::vec3(0.0f, 1.0f, 0.0f));
-		Text->RenderText("Press ENTER to retry or ESC to quit", 130.0f, this->Height / 2, 1.0f, glm::vec3(1.0f, 1.0f, 0.0f));
+		Text->RenderText(*WonText);
+		Text->RenderText(*RetryText);
 	}
+	if (Quality->EndFrame())
+		ApplyQuality();
 }
 
 
 void Game::ResetLevel()
 {
-	if (this->Level == 0)this->Levels[0].Load("levels/one.lvl", this->Width, this->Height * 0.5f);
-	else if (this->Level == 1)
+	if (Simulation->Level == 0)this->Levels[0].Load("levels/one.lvl", this->Width, this->Height * 0.5f);
+	else if (Simulation->Level == 1)
 		this->Levels[1].Load("levels/two.lvl", this->Width, this->Height * 0.5f);
-	else if (this->Level == 2)
+	else if (Simulation->Level == 2)
 		this->Levels[2].Load("levels/three.lvl", this->Width, this->Height * 0.5f);
-	else if (this->Level == 3)
+	else if (Simulation->Level == 3)
 		this->Levels[3].Load("levels/four.lvl", this->Width, this->Height * 0.5f);
 
-	this->Lives = 3;
+	Simulation->Lives = INITIAL_LIVES;
 }
 
 void Game::ResetPlayer()
@@ -527,17 +560,17 @@ GLboolean ShouldSpawn(GLuint chance)
 void Game::SpawnPowerUps(GameObject &block)
 {
 	if (ShouldSpawn(75)) // 1 in 75 chance
-		this->PowerUps.push_back(PowerUp("speed", glm::vec3(0.5f, 0.5f, 1.0f), 0.0f, block.Position, ResourceManager::GetTexture("powerup_speed")));
+		this->PowerUps.push_back(PowerUp("speed", glm::vec3(0.5f, 0.5f, 1.0f), 0.0f, block.Position, ResourceManager::GetTexture(POWERUP_SPEED_TEXTURE)));
 	if (ShouldSpawn(75))
-		this->PowerUps.push_back(PowerUp("sticky", glm::vec3(1.0f, 0.5f, 1.0f), 20.0f, block.Position, ResourceManager::GetTexture("powerup_sticky")));
+		this->PowerUps.push_back(PowerUp("sticky", glm::vec3(1.0f, 0.5f, 1.0f), 20.0f, block.Position, ResourceManager::GetTexture(POWERUP_STICKY_TEXTURE)));
 	if (ShouldSpawn(75))
-		this->PowerUps.push_back(PowerUp("pass-through", glm::vec3(0.5f, 1.0f, 0.5f), 10.0f, block.Position, ResourceManager::GetTexture("powerup_passthrough")));
+		this->PowerUps.push_back(PowerUp("pass-through", glm::vec3(0.5f, 1.0f, 0.5f), 10.0f, block.Position, ResourceManager::GetTexture(POWERUP_PASSTHROUGH_TEXTURE)));
 	if (ShouldSpawn(75))
-		this->PowerUps.push_back(PowerUp("pad-size-increase", glm::vec3(1.0f, 0.6f, 0.4), 0.0f, block.Position, ResourceManager::GetTexture("powerup_increase")));
+		this->PowerUps.push_back(PowerUp("pad-size-increase", glm::vec3(1.0f, 0.6f, 0.4), 0.0f, block.Position, ResourceManager::GetTexture(POWERUP_INCREASE_TEXTURE)));
 	if (ShouldSpawn(15)) // Negative powerups should spawn more often
-		this->PowerUps.push_back(PowerUp("confuse", glm::vec3(1.0f, 0.3f, 0.3f), 15.0f, block.Position, ResourceManager::GetTexture("powerup_confuse")));
+		this->PowerUps.push_back(PowerUp("confuse", glm::vec3(1.0f, 0.3f, 0.3f), 15.0f, block.Position, ResourceManager::GetTexture(POWERUP_CONFUSE_TEXTURE)));
 	if (ShouldSpawn(15))
-		this->PowerUps.push_back(PowerUp("chaos", glm::vec3(0.9f, 0.25f, 0.25f), 15.0f, block.Position, ResourceManager::GetTexture("powerup_chaos")));
+		this->PowerUps.push_back(PowerUp("chaos", glm::vec3(0.9f, 0.25f, 0.25f), 15.0f, block.Position, ResourceManager::GetTexture(POWERUP_CHAOS_TEXTURE)));
 }
 
 void ActivatePowerUp(PowerUp &powerUp)
@@ -587,104 +620,71 @@ GLboolean IsOtherPowerUpActive(std::vector<PowerUp> &powerUps, std::string type)
 }
 
 
-int cmon = -1;
-void Game::DoCollisions()
+void Game::HandleEvents()
 {
-
-
-	GameObject* lastCar = nullptr;
-	//for (GameObject &car : CarLevels2.at(this->Level).cars)
-	for (int i = 0; i < CarLevels2.at(this->Level).cars.size(); i++)
+	for (const SimulationEvent &event : Simulation->Events)
 	{
-		GameObject &car = CarLevels2.at(this->Level).cars.at(i);
-		if (cmon == 0)
-		{
-			std::cout << "vehicle code: " << car.code << std::endl;
-		}
-		if (car.code == vehicles::ICE && CheckCollision(*Car, car) && invincibleTime <= 0)
+		switch (event.Type)
 		{
-			icePointer = &car;
-		}
-		else if (car.code == vehicles::STAR && !car.Destroyed && CheckCollision(*Car, car))
-		{
-			invincibleTime = 8.0f;
-			Car->Color = CAR_COLOUR_I;
-			car.Destroyed = GL_TRUE;
+		case EVENT_CRASH:
+			SoundEngine->play2D("audio/crash.wav", GL_FALSE);
+			SpawnBurst(event.Position, event.Size, CRASH_PARTICLES, glm::vec3(1.0f, 0.6f, 0.2f), 150.0f);
+			Shake();
+			break;
+		case EVENT_SPLASH:
+			SoundEngine->play2D("audio/splash.wav", GL_FALSE);
+			SpawnBurst(event.Position, event.Size, SPLASH_PARTICLES, glm::vec3(0.3f, 0.5f, 1.0f), 100.0f);
+			Shake();
+			break;
+		case EVENT_STAR:
+			SpawnBurst(event.Position, event.Size, SPARKLE_PARTICLES, glm::vec3(1.0f, 0.9f, 0.3f), 120.0f);
 			mainTheme->setIsPaused(GL_TRUE);
 			SoundEngine->play2D("audio/bleep.mp3", GL_FALSE);
 			iTheme = SoundEngine->play2D("audio/breakout.mp3", GL_TRUE, GL_FALSE, GL_TRUE);
-			//Musichere
-		}
-		else if (car.code == vehicles::WATER && CheckCollision(*Car, car) && invincibleTime <= 0)
-		{
-			if (!CheckCollision(*Car, CarLevels2.at(this->Level).cars.at(i + 1)))
-			{
-				cmon += 1;
-				std::cout << lastCar->code << std::endl;
-				std::cout << "WATER THING: " << CarLevels2.at(this->Level).cars.at(i + 1).code;
-				SoundEngine->play2D("audio/splash.wav", GL_FALSE);
-				this->Lives -= 1;
-				invincibleTime = 1.5f;
-				Car->Color = CAR_COLOUR_I;
-				if (this->Lives == 0)
-				{
-					std::stringstream ss;
-					ss << (this->Level - 1);
-					CarLevels2.at(this->Level).Load(level_names.at(this->Level), this->Width, this->Height, CarLevels2.at(this->Level).fast);
-					this->Lives = 3;
-				}
-				else
-				{
-					ShakeTime = 0.1f;
-					Effects->Shake = GL_TRUE;
-				}
-			}
-		}
-		else if (car.code == 5 && CheckCollision(*Car, car))
-		{
-			
-			
-		}
-		else if ( CheckCollision(*Car, car) && !car.Destroyed && invincibleTime <= 0)
-		{
-			SoundEngine->play2D("audio/crash.wav", GL_FALSE);
-			car.Destroyed = GL_TRUE;
-			this->Lives -= 1;
-			invincibleTime = 1.5f;
-			Car->Color = CAR_COLOUR_I;
-			if (this->Lives == 0)
-			{
-				std::stringstream ss;
-				ss  << (this->Level - 1);
-				CarLevels2.at(this->Level).Load(level_names.at(this->Level), this->Width, this->Height, CarLevels2.at(this->Level).fast);
-				this->Lives = 3;
-			}
-			else
-			{
-				ShakeTime = 0.1f;
-				Effects->Shake = GL_TRUE;
-			}
+			break;
+		case EVENT_RECOVERED:
+			mainTheme->setIsPaused(GL_FALSE);
+			if (iTheme) iTheme->stop();
+			break;
+		case EVENT_FINISH:
+			SoundEngine->play2D("audio/cheer.wav", GL_FALSE);
+			break;
+		case EVENT_WON:
+			this->State = GAME_WIN;
+			break;
+		case EVENT_RESTART:
+			// Starting over, no need to shake about the last life
+			ShakeTime = 0.0f;
+			Effects->Shake = GL_FALSE;
+			break;
+		default:
+			break;
 		}
-		lastCar = &car;
-	}
-	if (CheckCollision(*Car, CarLevels2.at(this->Level).finish) && !CarLevels2.at(this->Level).finish.Destroyed)
-	{
-		CarLevels2.at(this->Level).finish.Destroyed = GL_TRUE;
-		SoundEngine->play2D("audio/cheer.wav", GL_FALSE);
-		this->Lives = 3;
 	}
 }
 
-GLboolean CheckCollision(GameObject &one, GameObject &two) // AABB - AABB collision
+void SpawnBurst(glm::vec2 position, glm::vec2 size, GLuint count, glm::vec3 color, GLfloat speed)
+{
+	// One-off burst from the center of an object, flying apart in all directions
+	ParticleEmitter burst(position + size * 0.5f, 0.0f, count, color);
+	burst.Spread = std::min(size.x, size.y) * 0.25f;
+	burst.Speed = speed;
+	Particles->Emit(burst);
+}
+
+void Shake()
+{
+	ShakeTime = 0.1f;
+	Effects->Shake = Quality->Current().Effects; // Cosmetic, lower tiers skip it
+}
+
+void ApplyQuality()
 {
-	// Collision x-axis?
-	GLboolean collisionX = one.Position.x + one.Size.x >= two.Position.x &&
-		two.Position.x + two.Size.x >= one.Position.x;
-	// Collision y-axis?
-	GLboolean collisionY = one.Position.y + one.Size.y >= two.Position.y &&
-		two.Position.y + two.Size.y >= one.Position.y;
-	// Collision only if on both axes
-	return collisionX && collisionY;
+	const QualityTier &tier = Quality->Current();
+	Effects->SetQuality(tier.Samples, tier.Resolution);
+	Particles->SpawnBudget = PARTICLE_SPAWN_BUDGET * tier.ParticleRate;
+	if (!tier.Effects)
+		Effects->Shake = GL_FALSE;
 }
 
 Collision CheckCollision(BallObject &one, GameObject &two) // AABB - Circle collision
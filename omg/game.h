@@ -17,10 +17,12 @@
 #include "game_object.h"
 #include "game_level.h"
 #include "car_level.h"
+#include "car_simulation.h"
 #include "power_up.h"
 
 // Represents the current state of the game
 enum GameState {
+	GAME_LOADING,
 	GAME_ACTIVE,
 	GAME_MENU,
 	GAME_WIN
@@ -41,23 +43,31 @@ const glm::vec2 PLAYER_SIZE(100, 20);
 
 const glm::vec2 MARIO_SIZE(150, 280);
 
-const glm::vec2 CAR_SIZE(50, 100);
-
-const glm::vec3 CAR_COLOUR(255.0 / 255.0, 187.0 / 255.0, 27.0 / 255.0);
-
-const glm::vec3 CAR_COLOUR_I(1 - (255.0 / 255.0), 1 - (187.0 / 255.0), 1 -(27.0 / 255.0));
-
 const float MARIO_JUMP_TIME = 1.0f;
 const float MARIO_JUMP_VELOCITY = 5.0f;
-const float ROAD_VELOCITY = 5.0f;
-// Initial velocity of the player paddle
-const GLfloat PLAYER_VELOCITY(500.0f);
 // Initial velocity of the Ball
 const glm::vec2 INITIAL_BALL_VELOCITY(100.0f, -350.0f);
 
 const glm::vec2 INITIAL_MARIO_VELOCITY(0.0f, -350.0f);
 // Radius of the ball object
 const GLfloat BALL_RADIUS = 12.5f;
+// Particles shared by all emitters, and how many of them may spawn per second
+const GLuint  PARTICLE_POOL_SIZE = 2000;
+const GLfloat PARTICLE_SPAWN_BUDGET = 1500.0f;
+// Simulate particles on the GPU with transform feedback instead of on the CPU
+const GLboolean PARTICLES_ON_GPU = GL_FALSE;
+// Exhaust spawn rates (particles per second) of the player and of each traffic car
+const GLfloat PLAYER_EXHAUST_RATE = 120.0f;
+const GLfloat TRAFFIC_EXHAUST_RATE = 40.0f;
+// Particles spawned at once for crash debris, water splashes and star sparkles
+const GLuint  CRASH_PARTICLES = 40;
+const GLuint  SPLASH_PARTICLES = 60;
+const GLuint  SPARKLE_PARTICLES = 40;
+
+// Seconds per frame the loading screen spends uploading textures
+const GLdouble LOADING_BUDGET = 0.008;
+// Frame time (in seconds) the quality governor tries to hold
+const GLfloat TARGET_FRAME_TIME = 1.0f / 60.0f;
 
 // Game holds all game-related state and functionality.
 // Combines all game-related data into a single class for
@@ -71,21 +81,22 @@ public:
 	GLboolean              KeysProcessed[1024];
 	GLuint                 Width, Height;
 	std::vector<GameLevel> Levels;
-	std::vector<CarLevel*> CarLevels;
-	std::vector<CarLevel> CarLevels2;
 	std::vector<PowerUp>   PowerUps;
-	GLuint                 Level;
-	GLuint                 Lives;
 	// Constructor/Destructor
 	Game(GLuint width, GLuint height);
 	~Game();
-	// Initialize game state (load all shaders/textures/levels)
+	// Initialize game state (load shaders, start loading textures)
 	void Init();
-	// GameLoop
+	// Set up everything that needs the textures (levels, game objects); called once they are loaded
+	void FinishInit();
+	// GameLoop; ProcessInput and Update advance the simulation by one step,
+	// Render draws alpha (0 to 1) of the way from the previous step to the last one
+	void SaveState();
 	void ProcessInput(GLfloat dt);
 	void Update(GLfloat dt);
-	void Render();
-	void DoCollisions();
+	void Render(GLfloat alpha = 1.0f);
+	// Sounds, particles and effects for what happened during the last simulation step
+	void HandleEvents();
 	// Reset
 	void ResetLevel();
 	void ResetPlayer();
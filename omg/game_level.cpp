@@ -8,33 +8,29 @@
 ******************************************************************/
 #include "game_level.h"
 
-#include <fstream>
-#include <sstream>
+#include "level_file.h"
+
+// Brick sprites, hashed by the compiler
+static constexpr ResourceName BLOCK_TEXTURE("block"), BLOCK_SOLID_TEXTURE("block_solid");
 
 
 void GameLevel::Load(const GLchar *file, GLuint levelWidth, GLuint levelHeight)
 {
 	// Clear old data
 	this->Bricks.clear();
-	// Load from file
-	GLuint tileCode;
-	GameLevel level;
-	std::string line;
-	std::ifstream fstream(file);
-	std::vector<std::vector<GLuint>> tileData;
-	if (fstream)
+	// Use the compiled level's tiles in place (compiling it on first use); otherwise parse the text level
+	MappedFile compiled;
+	LevelFileHeader header;
+	if (MapOrCompileLevel(file, "BLVL", 1, CompileBrickLevel, compiled, header) && header.Count == static_cast<uint64_t>(header.Width) * header.Height)
 	{
-		while (std::getline(fstream, line)) // Read each line from level file
-		{
-			std::istringstream sstream(line);
-			std::vector<GLuint> row;
-			while (sstream >> tileCode) // Read each word seperated by spaces
-				row.push_back(tileCode);
-			tileData.push_back(row);
-		}
-		if (tileData.size() > 0)
-			this->init(tileData, levelWidth, levelHeight);
+		if (header.Height > 0)
+			this->init(compiled.Data() + sizeof(header), header.Width, header.Height, levelWidth, levelHeight);
+		return;
 	}
+	std::vector<unsigned char> tileData;
+	GLuint width, height;
+	if (ReadBrickLevel(file, tileData, width, height) && height > 0)
+		this->init(tileData.data(), width, height, levelWidth, levelHeight);
 }
 
 void GameLevel::Draw(SpriteRenderer &renderer)
@@ -52,11 +48,9 @@ GLboolean GameLevel::IsCompleted()
 	return GL_TRUE;
 }
 
-void GameLevel::init(std::vector<std::vector<GLuint>> tileData, GLuint levelWidth, GLuint levelHeight)
+void GameLevel::init(const unsigned char *tileData, GLuint width, GLuint height, GLuint levelWidth, GLuint levelHeight)
 {
 	// Calculate dimensions
-	GLuint height = tileData.size();
-	GLuint width = tileData[0].size(); // Note we can index vector at [0] since this function is only called if height > 0
 	GLfloat unit_width = levelWidth / static_cast<GLfloat>(width), unit_height = levelHeight / height;
 	// Initialize level tiles based on tileData		
 	for (GLuint y = 0; y < height; ++y)
@@ -64,29 +58,29 @@ void GameLevel::init(std::vector<std::vector<GLuint>> tileData, GLuint levelWidt
 		for (GLuint x = 0; x < width; ++x)
 		{
 			// Check block type from level data (2D level array)
-			if (tileData[y][x] == 1) // Solid
+			if (tileData[y * width + x] == 1) // Solid
 			{
 				glm::vec2 pos(unit_width * x, unit_height * y);
 				glm::vec2 size(unit_width, unit_height);
-				GameObject obj(pos, size, ResourceManager::GetTexture("block_solid"), glm::vec3(0.8f, 0.8f, 0.7f));
+				GameObject obj(pos, size, ResourceManager::GetTexture(BLOCK_SOLID_TEXTURE), glm::vec3(0.8f, 0.8f, 0.7f));
 				obj.IsSolid = GL_TRUE;
 				this->Bricks.push_back(obj);
 			}
-			else if (tileData[y][x] > 1)	// Non-solid; now determine its color based on level data
+			else if (tileData[y * width + x] > 1)	// Non-solid; now determine its color based on level data
 			{
 				glm::vec3 color = glm::vec3(1.0f); // original: white
-				if (tileData[y][x] == 2)
+				if (tileData[y * width + x] == 2)
 					color = glm::vec3(0.2f, 0.6f, 1.0f);
-				else if (tileData[y][x] == 3)
+				else if (tileData[y * width + x] == 3)
 					color = glm::vec3(0.0f, 0.7f, 0.0f);
-				else if (tileData[y][x] == 4)
+				else if (tileData[y * width + x] == 4)
 					color = glm::vec3(0.8f, 0.8f, 0.4f);
-				else if (tileData[y][x] == 5)
+				else if (tileData[y * width + x] == 5)
 					color = glm::vec3(1.0f, 0.5f, 0.0f);
 
 				glm::vec2 pos(unit_width * x, unit_height * y);
 				glm::vec2 size(unit_width, unit_height);
-				this->Bricks.push_back(GameObject(pos, size, ResourceManager::GetTexture("block"), color));
+				this->Bricks.push_back(GameObject(pos, size, ResourceManager::GetTexture(BLOCK_TEXTURE), color));
 			}
 		}
 	}
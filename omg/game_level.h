@@ -29,15 +29,15 @@ public:
 	std::vector<GameObject> Bricks;
 	// Constructor
 	GameLevel() { }
-	// Loads level from file
+	// Loads level from file (or its compiled version, see level_file.h)
 	void      Load(const GLchar *file, GLuint levelWidth, GLuint levelHeight);
 	// Render level
 	void      Draw(SpriteRenderer &renderer);
 	// Check if the level is completed (all non-solid tiles are destroyed)
 	GLboolean IsCompleted();
 private:
-	// Initialize level from tile data
-	void      init(std::vector<std::vector<GLuint>> tileData, GLuint levelWidth, GLuint levelHeight);
+	// Initialize level from tile data (width * height tile codes, row by row)
+	void      init(const unsigned char *tileData, GLuint width, GLuint height, GLuint levelWidth, GLuint levelHeight);
 };
 
 #endif
\ No newline at end of file
@@ -7,15 +7,26 @@
 ** option) any later version.
 ******************************************************************/
 #include "game_object.h"
+#ifndef HEADLESS
+#include "sprite_renderer.h"
+#include "sprite_batch.h"
+#endif
 
 
 GameObject::GameObject()
-	: Position(0, 0), Size(1, 1), Velocity(0.0f), Color(1.0f), Rotation(0.0f), Sprite(), IsSolid(false), Destroyed(false), partner(nullptr) { }
+	: Position(0, 0), Size(1, 1), Velocity(0.0f), PreviousPosition(0, 0), Color(1.0f), Rotation(0.0f), IsSolid(false), Destroyed(false), partner(nullptr), Sprite() { }
 
 GameObject::GameObject(glm::vec2 pos, glm::vec2 size, Texture2D sprite, glm::vec3 color, glm::vec2 velocity)
-	: Position(pos), Size(size), Velocity(velocity), Color(color), Rotation(0.0f), Sprite(sprite), IsSolid(false), Destroyed(false), partner(nullptr) { }
+	: Position(pos), Size(size), Velocity(velocity), PreviousPosition(pos), Color(color), Rotation(0.0f), IsSolid(false), Destroyed(false), partner(nullptr), Sprite(sprite) { }
 
+#ifndef HEADLESS
 void GameObject::Draw(SpriteRenderer &renderer)
 {
 	renderer.DrawSprite(this->Sprite, this->Position, this->Size, this->Rotation, this->Color);
-}
\ No newline at end of file
+}
+
+void GameObject::Draw(SpriteBatch &batch, GLfloat alpha)
+{
+	batch.DrawSprite(this->Sprite, glm::mix(this->PreviousPosition, this->Position, alpha), this->Size, this->Rotation, this->Color);
+}
+#endif
@@ -10,11 +10,13 @@
 #ifndef GAMEOBJECT_H
 #define GAMEOBJECT_H
 
-#include <GL/glew.h>
 #include <glm/glm.hpp>
 
+#include "gl_types.h"
 #include "texture.h"
-#include "sprite_renderer.h"
+
+class SpriteRenderer;
+class SpriteBatch;
 
 
 // Container object for holding all state relevant for a single
@@ -25,6 +27,8 @@ class GameObject
 public:
 	// Object state
 	glm::vec2   Position, Size, Velocity;
+	// Position before the last simulation step; drawing interpolates between the two
+	glm::vec2   PreviousPosition;
 	glm::vec3   Color;
 	GLfloat     Rotation;
 	GLboolean   IsSolid;
@@ -36,8 +40,10 @@ public:
 	// Constructor(s)
 	GameObject();
 	GameObject(glm::vec2 pos, glm::vec2 size, Texture2D sprite, glm::vec3 color = glm::vec3(1.0f), glm::vec2 velocity = glm::vec2(0.0f, 0.0f));
-	// Draw sprite
-	virtual void Draw(SpriteRenderer &renderer);
+	// Draw sprite (not part of the headless build, so these can't be virtual)
+	void Draw(SpriteRenderer &renderer);
+	// Queue sprite into a batch, alpha of the way from PreviousPosition to Position
+	void Draw(SpriteBatch &batch, GLfloat alpha = 1.0f);
 };
 
 #endif
\ No newline at end of file
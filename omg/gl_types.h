@@ -0,0 +1,33 @@
+/*******************************************************************
+** This code is part of Breakout.
+**
+** Breakout is free software: you can redistribute it and/or modify
+** it under the terms of the CC BY 4.0 license as published by
+** Creative Commons, either version 4 of the License, or (at your
+** option) any later version.
+******************************************************************/
+#ifndef GL_TYPES_H
+#define GL_TYPES_H
+
+// The simulation (levels, game objects, collisions) only needs GL's types.
+// The headless build (HEADLESS defined) runs it without GL, so it gets
+// plain definitions of those instead of GLEW.
+#ifdef HEADLESS
+typedef unsigned int  GLenum;
+typedef unsigned char GLboolean;
+typedef int           GLint;
+typedef unsigned int  GLuint;
+typedef float         GLfloat;
+typedef double        GLdouble;
+typedef char          GLchar;
+
+#define GL_FALSE  0
+#define GL_TRUE   1
+#define GL_RGB    0x1907
+#define GL_LINEAR 0x2601
+#define GL_REPEAT 0x2901
+#else
+#include <GL/glew.h>
+#endif
+
+#endif
@@ -0,0 +1,143 @@
+/*******************************************************************
+** This code is part of Breakout.
+**
+** Breakout is free software: you can redistribute it and/or modify
+** it under the terms of the CC BY 4.0 license as published by
+** Creative Commons, either version 4 of the License, or (at your
+** option) any later version.
+******************************************************************/
+// Runs the car game without a window, GL or audio: an autopilot plays the
+// levels over and over for a number of fixed steps, as fast as the CPU
+// allows, and reports how many steps per second the simulation managed.
+// Built with -DHEADLESS (see the Makefile); run it from this directory so
+// it finds the levels. Usage: headless [steps] [level files...]
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+
+#include "car_simulation.h"
+
+// Size of the road (the game's window)
+const GLuint SCREEN_WIDTH = 800;
+const GLuint SCREEN_HEIGHT = 600;
+// Steps simulated unless given on the command line
+const unsigned long DEFAULT_STEPS = 1000000;
+// How far up the road (in pixels) and how often (in steps) the autopilot looks for a way through
+const GLfloat AUTOPILOT_LOOKAHEAD = 300.0f;
+const GLuint  AUTOPILOT_INTERVAL = 6;
+// Horizontal positions the autopilot considers, this far apart
+const GLfloat AUTOPILOT_SPACING = 10.0f;
+
+// Whether the player's car would be safe with its left edge at x for the next stretch of road;
+// only the cars in that stretch (nearby) need checking
+static GLboolean isClear(CarSimulation &simulation, const std::vector<GLuint> &nearby, GLfloat x)
+{
+	GameObject ahead = simulation.Player;
+	ahead.Position = glm::vec2(x, simulation.Player.Position.y - AUTOPILOT_LOOKAHEAD);
+	ahead.Size.y += AUTOPILOT_LOOKAHEAD;
+	std::vector<GameObject> &cars = simulation.Current().cars;
+	for (GLuint i : nearby)
+	{
+		const GameObject &car = cars[i];
+		if (!CheckCollision(ahead, car))
+			continue;
+		if ((car.code == vehicles::CAR || car.code == vehicles::DEER) && !car.Destroyed)
+			return GL_FALSE;
+		// Ice takes the steering away, so stay off it
+		if (car.code == vehicles::ICE)
+			return GL_FALSE;
+		// Water is only safe entirely on its bridge
+		if (car.code == vehicles::WATER)
+		{
+			if (i + 1 >= cars.size() || cars[i + 1].code != vehicles::BRIDGE)
+				return GL_FALSE;
+			const GameObject &bridge = cars[i + 1];
+			if (x < bridge.Position.x || x + ahead.Size.x > bridge.Position.x + bridge.Size.x)
+				return GL_FALSE;
+		}
+	}
+	return GL_TRUE;
+}
+
+// Picks the clear position across the road nearest to the car; stays put if there is none
+static GLfloat autopilot(CarSimulation &simulation, std::vector<GLuint> &nearby)
+{
+	// Everything on the stretch of road ahead, across its whole width
+	GameObject ahead;
+	ahead.Position = glm::vec2(0.0f, simulation.Player.Position.y - AUTOPILOT_LOOKAHEAD);
+	ahead.Size = glm::vec2(simulation.Width, simulation.Player.Size.y + AUTOPILOT_LOOKAHEAD);
+	simulation.Current().Index.Query(simulation.Current().cars, ahead, nearby);
+	GLfloat current = simulation.Player.Position.x, best = current, bestDistance = -1.0f;
+	for (GLfloat x = 0.0f; x <= simulation.Width - simulation.Player.Size.x; x += AUTOPILOT_SPACING)
+	{
+		GLfloat distance = std::abs(x - current);
+		if ((bestDistance < 0.0f || distance < bestDistance) && isClear(simulation, nearby, x))
+		{
+			best = x;
+			bestDistance = distance;
+		}
+	}
+	return best;
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned long steps = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : DEFAULT_STEPS;
+	// Level loading picks random traffic colours; a fixed seed keeps runs comparable
+	srand(1);
+	CarSimulation simulation(SCREEN_WIDTH, SCREEN_HEIGHT);
+	// The game's levels unless others are given, each faster than the one before
+	std::vector<std::string> files(argv + std::min(argc, 2), argv + argc);
+	if (files.empty())
+		files = { "levels/1.txt", "levels/2.txt", "levels/3.txt" };
+	for (GLuint i = 0; i < files.size(); ++i)
+		simulation.AddLevel(files[i], ROAD_VELOCITY + 2.5f * i);
+	// Every restart and every new game load levels again, so it's worth knowing what that costs
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	simulation.Start(0);
+	std::chrono::duration<double, std::milli> loading = std::chrono::steady_clock::now() - start;
+
+	unsigned long crashes = 0, splashes = 0, restarts = 0, levels = 0, wins = 0;
+	GLfloat target = simulation.Player.Position.x;
+	std::vector<GLuint> nearby;
+	start = std::chrono::steady_clock::now();
+	for (unsigned long step = 0; step < steps; ++step)
+	{
+		// Steer towards the chosen spot, without overshooting it
+		if (step % AUTOPILOT_INTERVAL == 0)
+			target = autopilot(simulation, nearby);
+		GLfloat reach = PLAYER_VELOCITY * SIMULATION_STEP;
+		GLfloat direction = glm::clamp((target - simulation.Player.Position.x) / reach, -1.0f, 1.0f);
+		simulation.SavePositions();
+		simulation.Steer(glm::vec2(direction, 0.0f), SIMULATION_STEP);
+		simulation.Step(SIMULATION_STEP);
+		for (const SimulationEvent &event : simulation.Events)
+		{
+			switch (event.Type)
+			{
+			case EVENT_CRASH:          ++crashes; break;
+			case EVENT_SPLASH:         ++splashes; break;
+			case EVENT_RESTART:        ++restarts; break;
+			case EVENT_LEVEL_COMPLETE: ++levels; break;
+			case EVENT_WON:
+				// Play again from the start
+				++levels;
+				++wins;
+				simulation.Start(0);
+				target = simulation.Player.Position.x;
+				break;
+			default: break;
+			}
+		}
+	}
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+	std::cout << "Loaded " << files.size() << " levels in " << loading.count() << " ms" << std::endl;
+	std::cout << "Simulated " << steps << " steps (" << steps * SIMULATION_STEP << " s of play) in "
+		<< elapsed.count() << " s: " << static_cast<unsigned long>(steps / elapsed.count()) << " steps/s" << std::endl;
+	std::cout << "Levels completed: " << levels << ", games won: " << wins << ", lives lost: " << crashes + splashes
+		<< " (" << crashes << " crashes, " << splashes << " splashes), level restarts: " << restarts << std::endl;
+	return 0;
+}
@@ -0,0 +1,151 @@
+/*******************************************************************
+** This code is part of Breakout.
+**
+** Breakout is free software: you can redistribute it and/or modify
+** it under the terms of the CC BY 4.0 license as published by
+** Creative Commons, either version 4 of the License, or (at your
+** option) any later version.
+******************************************************************/
+// Measures what reading a level costs from its text and from its compiled
+// version, on synthetic car levels and breakout grids of growing size
+// (written next to the binary and removed afterwards). Built with
+// -DHEADLESS (see the Makefile). Usage: level_bench [records...]
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "level_file.h"
+#include "level_reader.h"
+
+// Level sizes measured unless given on the command line
+const GLuint DEFAULT_SIZES[] = { 1000, 100000, 1000000 };
+// Where the synthetic levels are written
+const char CAR_LEVEL[] = "level_bench.txt";
+const char BRICK_LEVEL[] = "level_bench.lvl";
+// Tiles per row of the synthetic breakout grids
+const GLuint GRID_WIDTH = 100;
+
+typedef std::chrono::steady_clock Clock;
+
+// Milliseconds since start
+static double since(Clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// Bytes in a file
+static long fileSize(const std::string &file)
+{
+	FILE *f = fopen(file.c_str(), "rb");
+	if (!f)
+		return 0;
+	fseek(f, 0, SEEK_END);
+	long size = ftell(f);
+	fclose(f);
+	return size;
+}
+
+// A car level like the text levels, only longer: mostly traffic, with the odd deer and star
+static void makeCarLevel(GLuint count)
+{
+	FILE *file = fopen(CAR_LEVEL, "w");
+	fprintf(file, "SECONDS VEHICLE_CODE POSITION VELOCITY\n");
+	GLuint quarters = 4;
+	for (GLuint i = 0; i < count; ++i)
+	{
+		quarters += 1 + rand() % 4;
+		int roll = rand() % 20, vehicle = roll == 0 ? 1 : roll == 1 ? 3 : 0;
+		fprintf(file, "%g %d %d %g\n", quarters / 4.0, vehicle, rand() % 8, (rand() % 5) / 2.0);
+	}
+	fclose(file);
+}
+
+// A breakout grid of count tiles, GRID_WIDTH to a row
+static void makeBrickLevel(GLuint count)
+{
+	FILE *file = fopen(BRICK_LEVEL, "w");
+	for (GLuint i = 0; i < count; ++i)
+		fprintf(file, "%d%s", rand() % 6, (i + 1) % GRID_WIDTH == 0 || i + 1 == count ? "\n" : " ");
+	fclose(file);
+}
+
+// Reads every record of a car level; returns a checksum to compare the readers by
+static double readAll(LevelReader &reader)
+{
+	LevelRecord record;
+	double sum = 0.0;
+	while (reader.Next(record))
+		sum += record.Time + record.Vehicle + record.Position + record.Speed;
+	return sum;
+}
+
+static void report(const char *kind, GLuint size, const std::string &file, double compile, double text, double compiled, bool same)
+{
+	std::string target = file + COMPILED_LEVEL_SUFFIX;
+	std::printf("%-6s %10u %12ld %12ld %12.2f %12.2f %12.2f %9.0fx%s\n", kind, size, fileSize(file), fileSize(target),
+		compile, text, compiled, text / compiled, same ? "" : "  MISMATCH");
+}
+
+int main(int argc, char *argv[])
+{
+	std::vector<GLuint> sizes;
+	for (int i = 1; i < argc; ++i)
+		sizes.push_back(std::strtoul(argv[i], nullptr, 10));
+	if (sizes.empty())
+		sizes.assign(DEFAULT_SIZES, DEFAULT_SIZES + sizeof(DEFAULT_SIZES) / sizeof(DEFAULT_SIZES[0]));
+
+	std::string carTarget = std::string(CAR_LEVEL) + COMPILED_LEVEL_SUFFIX;
+	std::string brickTarget = std::string(BRICK_LEVEL) + COMPILED_LEVEL_SUFFIX;
+	std::printf("%-6s %10s %12s %12s %12s %12s %12s %10s\n", "level", "records", "text bytes", "blv bytes", "compile ms", "text ms", "mapped ms", "speedup");
+	for (GLuint size : sizes)
+	{
+		srand(1);
+		// Car levels: every record read through the streaming readers
+		makeCarLevel(size);
+		Clock::time_point start = Clock::now();
+		bool compiled = CompileCarLevel(CAR_LEVEL, carTarget);
+		double compile = since(start);
+		start = Clock::now();
+		TextLevelReader text(CAR_LEVEL);
+		double textSum = readAll(text);
+		double textTime = since(start);
+		start = Clock::now();
+		BinaryLevelReader binary;
+		double binarySum = binary.Open(CAR_LEVEL) ? readAll(binary) : -1.0;
+		double binaryTime = since(start);
+		report("car", size, CAR_LEVEL, compile, textTime, binaryTime, compiled && textSum == binarySum);
+
+		// Breakout grids: the tiles parsed or mapped, as GameLevel::Load gets them
+		makeBrickLevel(size);
+		start = Clock::now();
+		compiled = CompileBrickLevel(BRICK_LEVEL, brickTarget);
+		compile = since(start);
+		start = Clock::now();
+		std::vector<unsigned char> tiles;
+		GLuint width, height;
+		ReadBrickLevel(BRICK_LEVEL, tiles, width, height);
+		unsigned long textTiles = 0;
+		for (unsigned char tile : tiles)
+			textTiles += tile;
+		textTime = since(start);
+		start = Clock::now();
+		MappedFile mapping;
+		LevelFileHeader header;
+		unsigned long mappedTiles = 0;
+		if (MapLevel(BRICK_LEVEL, "BLVL", 1, mapping, header))
+		{
+			const unsigned char *tile = mapping.Data() + sizeof(header);
+			for (uint64_t i = 0; i < header.Count; ++i)
+				mappedTiles += tile[i];
+		}
+		binaryTime = since(start);
+		report("brick", size, BRICK_LEVEL, compile, textTime, binaryTime, compiled && textTiles == mappedTiles);
+	}
+	remove(CAR_LEVEL);
+	remove(carTarget.c_str());
+	remove(BRICK_LEVEL);
+	remove(brickTarget.c_str());
+	return 0;
+}
@@ -0,0 +1,55 @@
+/*******************************************************************
+** This code is part of Breakout.
+**
+** Breakout is free software: you can redistribute it and/or modify
+** it under the terms of the CC BY 4.0 license as published by
+** Creative Commons, either version 4 of the License, or (at your
+** option) any later version.
+******************************************************************/
+// Compiles text levels into the binary format of level_file.h, next to
+// them (file + COMPILED_LEVEL_SUFFIX), where the game picks them up
+// instead of parsing the text. Car levels end in .txt, breakout levels in
+// .lvl. Built with -DHEADLESS (see the Makefile).
+// Usage: level_compiler [level files...]
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "level_file.h"
+
+// Levels compiled unless given on the command line
+const char *DEFAULT_LEVELS[] = {
+	"levels/1.txt", "levels/2.txt", "levels/3.txt",
+	"levels/one.lvl", "levels/two.lvl", "levels/three.lvl", "levels/four.lvl"
+};
+
+// Whether name ends in suffix
+static bool endsWith(const std::string &name, const std::string &suffix)
+{
+	return name.size() >= suffix.size() && name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+int main(int argc, char *argv[])
+{
+	std::vector<std::string> files(argv + 1, argv + argc);
+	if (files.empty())
+		files.assign(DEFAULT_LEVELS, DEFAULT_LEVELS + sizeof(DEFAULT_LEVELS) / sizeof(DEFAULT_LEVELS[0]));
+
+	int failed = 0;
+	for (const std::string &file : files)
+	{
+		std::string target = file + COMPILED_LEVEL_SUFFIX;
+		bool compiled = false;
+		if (endsWith(file, ".lvl"))
+			compiled = CompileBrickLevel(file.c_str(), target);
+		else if (endsWith(file, ".txt"))
+			compiled = CompileCarLevel(file.c_str(), target);
+		else
+			std::printf("Skipped %s (not a .txt or .lvl level)\n", file.c_str());
+		if (compiled)
+			std::printf("Compiled %s to %s\n", file.c_str(), target.c_str());
+		else
+			++failed;
+	}
+	return failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,195 @@
+/*******************************************************************
+** This code is part of Breakout.
+**
+** Breakout is free software: you can redistribute it and/or modify
+** it under the terms of the CC BY 4.0 license as published by
+** Creative Commons, either version 4 of the License, or (at your
+** option) any later version.
+******************************************************************/
+#include "level_file.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <sys/stat.h>
+
+#include "level_reader.h"
+
+
+// Size and modification time of a file; returns false if it doesn't exist
+static bool sourceStamp(const GLchar *file, uint64_t &size, uint64_t &time)
+{
+	struct stat source;
+	if (stat(file, &source) != 0)
+		return false;
+	size = static_cast<uint64_t>(source.st_size);
+	time = static_cast<uint64_t>(source.st_mtime);
+	return true;
+}
+
+// Maps path if it is a complete compiled level with the given magic
+static bool mapCompiled(const std::string &path, const char magic[4], size_t recordSize, MappedFile &mapping, LevelFileHeader &header)
+{
+	if (!mapping.Open(path) || mapping.Size() < sizeof(header))
+	{
+		mapping.Close();
+		return false;
+	}
+	memcpy(&header, mapping.Data(), sizeof(header));
+	bool valid = memcmp(header.Magic, magic, 4) == 0 && header.Version == LEVEL_FILE_VERSION &&
+		header.Count <= (mapping.Size() - sizeof(header)) / recordSize;
+	if (!valid)
+		mapping.Close();
+	return valid;
+}
+
+bool MapLevel(const GLchar *file, const char magic[4], size_t recordSize, MappedFile &mapping, LevelFileHeader &header)
+{
+	uint64_t sourceSize = 0, sourceTime = 0;
+	bool haveSource = sourceStamp(file, sourceSize, sourceTime);
+	// A compiled level older than its text level is ignored, the text is read instead
+	if (mapCompiled(std::string(file) + COMPILED_LEVEL_SUFFIX, magic, recordSize, mapping, header) &&
+		(!haveSource || (header.SourceSize == sourceSize && header.SourceTime == sourceTime)))
+		return true;
+	mapping.Close();
+	return haveSource && mapCompiled(file, magic, recordSize, mapping, header);
+}
+
+bool MapOrCompileLevel(const GLchar *file, const char magic[4], size_t recordSize, bool (*compile)(const GLchar *file, const std::string &target),
+	MappedFile &mapping, LevelFileHeader &header)
+{
+	if (MapLevel(file, magic, recordSize, mapping, header))
+		return true;
+	// Only text levels that exist are compiled, not a broken compiled level given directly
+	std::string name(file), suffix(COMPILED_LEVEL_SUFFIX);
+	uint64_t sourceSize, sourceTime;
+	bool compiled = name.size() >= suffix.size() && name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0;
+	if (compiled || !sourceStamp(file, sourceSize, sourceTime) || !compile(file, name + suffix))
+		return false;
+	return MapLevel(file, magic, recordSize, mapping, header);
+}
+
+bool ReadBrickLevel(const GLchar *file, std::vector<unsigned char> &tiles, GLuint &width, GLuint &height)
+{
+	tiles.clear();
+	width = height = 0;
+	GLuint tileCode;
+	std::string line;
+	std::ifstream fstream(file);
+	if (!fstream)
+		return false;
+	while (std::getline(fstream, line)) // Read each line from level file
+	{
+		std::istringstream sstream(line);
+		// The first row decides the width; shorter rows are filled up with empty tiles
+		GLuint x = 0;
+		tiles.resize(tiles.size() + width);
+		while (sstream >> tileCode) // Read each word seperated by spaces
+		{
+			unsigned char code = static_cast<unsigned char>(std::min<GLuint>(tileCode, 255));
+			if (height == 0)
+				tiles.push_back(code);
+			else if (x < width)
+				tiles[height * width + x] = code;
+			++x;
+		}
+		if (height == 0)
+			width = x;
+		++height;
+	}
+	return true;
+}
+
+// Written in place of the header until the whole level is, so a file left half written (the game
+// compiles levels as it loads them) doesn't pass for a compiled level
+static const LevelFileHeader BLANK_HEADER = LevelFileHeader();
+
+// Writes what CompileCarLevel and CompileBrickLevel produced, or removes it again if that failed
+static bool finishCompiled(FILE *file, const LevelFileHeader &header, bool written, const std::string &target)
+{
+	// The header is written again now the records are counted
+	written = written && fseek(file, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, file) == 1;
+	written = fclose(file) == 0 && written;
+	if (!written)
+		remove(target.c_str());
+	return written;
+}
+
+// A header for a compiled version of file, with no records yet
+static LevelFileHeader compiledHeader(const GLchar *file, const char magic[4])
+{
+	LevelFileHeader header;
+	memcpy(header.Magic, magic, 4);
+	header.Version = LEVEL_FILE_VERSION;
+	header.SourceSize = header.SourceTime = 0;
+	sourceStamp(file, header.SourceSize, header.SourceTime);
+	header.Count = 0;
+	header.Width = header.Height = 0;
+	return header;
+}
+
+bool CompileCarLevel(const GLchar *file, const std::string &target)
+{
+	TextLevelReader reader(file);
+	if (!reader.IsOpen())
+	{
+		std::cout << "ERROR::LEVEL: Failed to read " << file << std::endl;
+		return false;
+	}
+	FILE *out = fopen(target.c_str(), "wb");
+	if (!out)
+	{
+		std::cout << "ERROR::LEVEL: Failed to write " << target << std::endl;
+		return false;
+	}
+	LevelFileHeader header = compiledHeader(file, "CLVL");
+	bool written = fwrite(&BLANK_HEADER, sizeof(BLANK_HEADER), 1, out) == 1;
+	LevelRecord record;
+	int64_t time = 0;
+	while (written && reader.Next(record))
+	{
+		PackedCarRecord packed;
+		int64_t ticks = std::llround(record.Time * static_cast<double>(LEVEL_TIME_UNITS));
+		packed.TimeDelta = static_cast<int32_t>(ticks - time);
+		packed.Vehicle = static_cast<uint8_t>(record.Vehicle);
+		packed.Position = static_cast<int8_t>(record.Position);
+		packed.Speed = record.Speed;
+		// Everything has to read back exactly as the text level gives it
+		if (LevelTime(ticks) != record.Time || packed.TimeDelta != ticks - time ||
+			packed.Vehicle != record.Vehicle || packed.Position != record.Position)
+		{
+			std::cout << "ERROR::LEVEL: Record " << header.Count + 1 << " of " << file << " can't be compiled exactly" << std::endl;
+			written = false;
+			break;
+		}
+		time = ticks;
+		written = fwrite(&packed, sizeof(packed), 1, out) == 1;
+		++header.Count;
+	}
+	return finishCompiled(out, header, written, target);
+}
+
+bool CompileBrickLevel(const GLchar *file, const std::string &target)
+{
+	std::vector<unsigned char> tiles;
+	LevelFileHeader header = compiledHeader(file, "BLVL");
+	if (!ReadBrickLevel(file, tiles, header.Width, header.Height))
+	{
+		std::cout << "ERROR::LEVEL: Failed to read " << file << std::endl;
+		return false;
+	}
+	FILE *out = fopen(target.c_str(), "wb");
+	if (!out)
+	{
+		std::cout << "ERROR::LEVEL: Failed to write " << target << std::endl;
+		return false;
+	}
+	header.Count = tiles.size();
+	bool written = fwrite(&BLANK_HEADER, sizeof(BLANK_HEADER), 1, out) == 1 &&
+		fwrite(tiles.data(), 1, tiles.size(), out) == tiles.size();
+	return finishCompiled(out, header, written, target);
+}
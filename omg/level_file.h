@@ -0,0 +1,67 @@
+/*******************************************************************
+** This code is part of Breakout.
+**
+** Breakout is free software: you can redistribute it and/or modify
+** it under the terms of the CC BY 4.0 license as published by
+** Creative Commons, either version 4 of the License, or (at your
+** option) any later version.
+******************************************************************/
+#ifndef LEVEL_FILE_H
+#define LEVEL_FILE_H
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "gl_types.h"
+#include "mapped_file.h"
+
+// Compiled levels sit next to their text level, e.g. levels/1.txt.blv
+const char COMPILED_LEVEL_SUFFIX[] = ".blv";
+// Bump whenever the layout of compiled levels changes
+const uint32_t LEVEL_FILE_VERSION = 1;
+// Car level times are stored in milliseconds
+const GLfloat LEVEL_TIME_UNITS = 1000.0f;
+
+// Header of a compiled level. A car level ("CLVL") is followed by Count
+// PackedCarRecords, a breakout level ("BLVL") by Count = Width * Height
+// tile codes of one byte each, row by row.
+struct LevelFileHeader {
+	char     Magic[4];
+	uint32_t Version;
+	uint64_t SourceSize; // Size and modification time of the text level it was compiled from,
+	uint64_t SourceTime; // used to notice when the source changed
+	uint64_t Count;
+	uint32_t Width, Height;
+};
+
+// A car level record, in the order of the text level. Only the time between
+// records is stored, which keeps them small and exact.
+#pragma pack(push, 1)
+struct PackedCarRecord {
+	int32_t TimeDelta; // Milliseconds after the previous record (negative if the level is out of order)
+	uint8_t Vehicle;
+	int8_t  Position;
+	float   Speed;
+};
+#pragma pack(pop)
+
+// Seconds into the level of a time in LEVEL_TIME_UNITS
+inline GLdouble LevelTime(int64_t ticks)
+{
+	return ticks / static_cast<GLdouble>(LEVEL_TIME_UNITS);
+}
+
+// Maps the compiled level of file (or file itself, if it is a compiled level)
+// with the given magic; returns false if there is none that is valid and up to date
+bool MapLevel(const GLchar *file, const char magic[4], size_t recordSize, MappedFile &mapping, LevelFileHeader &header);
+// Like MapLevel, but compiles file with compile first if its compiled level is missing or out of date
+// (like baked textures, a level that can't be compiled, e.g. on a read-only install, is still readable as text)
+bool MapOrCompileLevel(const GLchar *file, const char magic[4], size_t recordSize, bool (*compile)(const GLchar *file, const std::string &target),
+	MappedFile &mapping, LevelFileHeader &header);
+// Parses a text breakout level (rows of space separated tile codes) into a Width * Height grid
+bool ReadBrickLevel(const GLchar *file, std::vector<unsigned char> &tiles, GLuint &width, GLuint &height);
+// Compile a text level to target (usually file + COMPILED_LEVEL_SUFFIX); return false if it can't be represented exactly
+bool CompileCarLevel(const GLchar *file, const std::string &target);
+bool CompileBrickLevel(const GLchar *file, const std::string &target);
+
+#endif
@@ -0,0 +1,84 @@
+/*******************************************************************
+** This code is part of Breakout.
+**
+** Breakout is free software: you can redistribute it and/or modify
+** it under the terms of the CC BY 4.0 license as published by
+** Creative Commons, either version 4 of the License, or (at your
+** option) any later version.
+******************************************************************/
+#include "level_reader.h"
+
+#include <cstring>
+#include <sstream>
+#include <string>
+
+#include "level_file.h"
+
+
+std::shared_ptr<LevelReader> LevelReader::Open(const GLchar *file)
+{
+	std::shared_ptr<BinaryLevelReader> compiled = std::make_shared<BinaryLevelReader>();
+	if (compiled->Open(file))
+		return compiled;
+	std::shared_ptr<TextLevelReader> reader = std::make_shared<TextLevelReader>(file);
+	if (!reader->IsOpen())
+		return nullptr;
+	return reader;
+}
+
+TextLevelReader::TextLevelReader(const GLchar *file)
+	: stream(file)
+{
+	std::string line;
+	std::getline(this->stream, line);	//First line is a throw away
+}
+
+GLboolean TextLevelReader::IsOpen() const
+{
+	return this->stream.is_open();
+}
+
+GLboolean TextLevelReader::Next(LevelRecord &record)
+{
+	std::string line;
+	while (std::getline(this->stream, line)) // Read each line from level file
+	{
+		std::istringstream sstream(line);
+		if (sstream >> record.Time >> record.Vehicle >> record.Position >> record.Speed)
+			return GL_TRUE;
+	}
+	return GL_FALSE;
+}
+
+BinaryLevelReader::BinaryLevelReader()
+	: records(nullptr), count(0), next(0), time(0)
+{
+
+}
+
+GLboolean BinaryLevelReader::Open(const GLchar *file)
+{
+	LevelFileHeader header;
+	if (!MapOrCompileLevel(file, "CLVL", sizeof(PackedCarRecord), CompileCarLevel, this->mapping, header))
+		return GL_FALSE;
+	this->records = this->mapping.Data() + sizeof(header);
+	this->count = header.Count;
+	this->next = 0;
+	this->time = 0;
+	return GL_TRUE;
+}
+
+GLboolean BinaryLevelReader::Next(LevelRecord &record)
+{
+	if (this->next >= this->count)
+		return GL_FALSE;
+	PackedCarRecord packed;
+	memcpy(&packed, this->records + this->next * sizeof(packed), sizeof(packed));
+	++this->next;
+	this->time += packed.TimeDelta;
+	record.Time = LevelTime(this->time);
+	record.Vehicle = packed.Vehicle;
+	record.Position = packed.Position;
+	record.Speed = packed.Speed;
+	return GL_TRUE;
+}
@@ -0,0 +1,71 @@
+/*******************************************************************
+** This code is part of Breakout.
+**
+** Breakout is free software: you can redistribute it and/or modify
+** it under the terms of the CC BY 4.0 license as published by
+** Creative Commons, either version 4 of the License, or (at your
+** option) any later version.
+******************************************************************/
+#ifndef LEVEL_READER_H
+#define LEVEL_READER_H
+#include <cstdint>
+#include <fstream>
+#include <memory>
+
+#include "gl_types.h"
+#include "mapped_file.h"
+
+// One vehicle of a car level, as written in the level file
+struct LevelRecord {
+	GLdouble Time;     // Seconds of driving until it reaches the top of the screen
+	GLint    Vehicle;  // Kind of vehicle (see vehicles)
+	GLint    Position; // Lane, in eighths of the road's width
+	GLfloat  Speed;    // Its own speed on top of the road's
+};
+
+// LevelReader hands out the records of a car level one at a time, in the
+// order they are stored, so a level never has to be in memory as a whole.
+// Levels are stored ordered by time (give or take a little, see CarLevel).
+class LevelReader
+{
+public:
+	virtual ~LevelReader() { }
+	// Reads the next record; returns false at the end of the level
+	virtual GLboolean Next(LevelRecord &record) = 0;
+	// Opens a level file for reading, from its compiled version (compiled now if it is missing or out of date); returns nullptr if it can't be opened
+	static std::shared_ptr<LevelReader> Open(const GLchar *file);
+};
+
+// Reads the text format: a header line, then one "SECONDS VEHICLE_CODE
+// POSITION VELOCITY" record per line. Lines that don't parse are skipped.
+class TextLevelReader : public LevelReader
+{
+public:
+	// Constructor (opens the file and skips the header)
+	TextLevelReader(const GLchar *file);
+	// Whether the file could be opened
+	GLboolean IsOpen() const;
+	GLboolean Next(LevelRecord &record) override;
+private:
+	std::ifstream stream;
+};
+
+// Reads a compiled level (see level_file.h) in place from a memory mapping;
+// the records only need their times added up.
+class BinaryLevelReader : public LevelReader
+{
+public:
+	// Constructor
+	BinaryLevelReader();
+	// Maps the compiled version of file, compiling it first if needed; returns false if it can't be compiled
+	GLboolean Open(const GLchar *file);
+	GLboolean Next(LevelRecord &record) override;
+private:
+	MappedFile           mapping;
+	const unsigned char *records;
+	// Records in the file and read so far, and the time of the last one read (in LEVEL_TIME_UNITS)
+	uint64_t             count, next;
+	int64_t              time;
+};
+
+#endif
@@ -0,0 +1,93 @@
+/*******************************************************************
+** This code is part of Breakout.
+**
+** Breakout is free software: you can redistribute it and/or modify
+** it under the terms of the CC BY 4.0 license as published by
+** Creative Commons, either version 4 of the License, or (at your
+** option) any later version.
+******************************************************************/
+#include "mapped_file.h"
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+MappedFile::MappedFile()
+	: mapping(nullptr), mappingSize(0)
+#ifdef _WIN32
+	, fileHandle(nullptr), mappingHandle(nullptr)
+#endif
+{ }
+
+MappedFile::~MappedFile()
+{
+	this->Close();
+}
+
+bool MappedFile::Open(const std::string &path)
+{
+	this->Close();
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+	LARGE_INTEGER size;
+	GetFileSizeEx(file, &size);
+	HANDLE view = size.QuadPart > 0 ? CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL) : NULL;
+	this->fileHandle = file;
+	this->mappingHandle = view;
+	this->mapping = view ? MapViewOfFile(view, FILE_MAP_READ, 0, 0, 0) : nullptr;
+	this->mappingSize = static_cast<size_t>(size.QuadPart);
+#else
+	int file = open(path.c_str(), O_RDONLY);
+	if (file < 0)
+		return false;
+	struct stat info;
+	fstat(file, &info);
+	this->mappingSize = static_cast<size_t>(info.st_size);
+	this->mapping = this->mappingSize > 0 ? mmap(nullptr, this->mappingSize, PROT_READ, MAP_PRIVATE, file, 0) : MAP_FAILED;
+	if (this->mapping == MAP_FAILED)
+		this->mapping = nullptr;
+	close(file); // The mapping stays valid
+#endif
+	if (!this->mapping)
+	{
+		this->Close();
+		return false;
+	}
+	return true;
+}
+
+void MappedFile::Close()
+{
+#ifdef _WIN32
+	if (this->mapping)
+		UnmapViewOfFile(this->mapping);
+	if (this->mappingHandle)
+		CloseHandle(this->mappingHandle);
+	if (this->fileHandle)
+		CloseHandle(this->fileHandle);
+	this->fileHandle = this->mappingHandle = nullptr;
+#else
+	if (this->mapping)
+		munmap(this->mapping, this->mappingSize);
+#endif
+	this->mapping = nullptr;
+	this->mappingSize = 0;
+}
+
+const unsigned char *MappedFile::Data() const
+{
+	return static_cast<const unsigned char*>(this->mapping);
+}
+
+size_t MappedFile::Size() const
+{
+	return this->mappingSize;
+}
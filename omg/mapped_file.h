@@ -0,0 +1,43 @@
+/*******************************************************************
+** This code is part of Breakout.
+**
+** Breakout is free software: you can redistribute it and/or modify
+** it under the terms of the CC BY 4.0 license as published by
+** Creative Commons, either version 4 of the License, or (at your
+** option) any later version.
+******************************************************************/
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+#include <cstddef>
+#include <string>
+
+
+// MappedFile maps a whole file read-only into memory, so its contents can
+// be used in place instead of being read and copied. Pages are only loaded
+// as they are touched, and the OS may drop them again, so even very large
+// files cost address space rather than memory.
+class MappedFile
+{
+public:
+	// Constructor/Destructor
+	MappedFile();
+	~MappedFile();
+	// Maps the file (unmapping any previous one); returns false if it can't be opened or is empty
+	bool Open(const std::string &path);
+	// Unmaps the file, if any
+	void Close();
+	// Contents of the file; valid until it is closed
+	const unsigned char *Data() const;
+	size_t Size() const;
+private:
+	void  *mapping;
+	size_t mappingSize;
+#ifdef _WIN32
+	void  *fileHandle, *mappingHandle;
+#endif
+	// Not copyable, it owns the mapping
+	MappedFile(const MappedFile&);
+	MappedFile &operator=(const MappedFile&);
+};
+
+#endif
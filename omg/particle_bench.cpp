@@ -0,0 +1,162 @@
+/*******************************************************************
+** This code is part of Breakout.
+**
+** Breakout is free software: you can redistribute it and/or modify
+** it under the terms of the CC BY 4.0 license as published by
+** Creative Commons, either version 4 of the License, or (at your
+** option) any later version.
+******************************************************************/
+// Measures the CPU particle update per core: the array of structs with a
+// branch per particle that ParticleGenerator used to run, the structure
+// of arrays updated one particle at a time, and the SIMD kernel the game
+// runs (UpdateParticles). All three start from the same particles and
+// must end with the same live ones. Built with -DHEADLESS (see the
+// Makefile). Usage: particle_bench [steps] [particles...]
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "particle_data.h"
+
+// Pool sizes measured unless given on the command line
+const GLuint DEFAULT_SIZES[] = { 1000, 100000, 1000000 };
+// Steps of a 60 Hz frame; particles live 0.5 to 3 seconds, so about a fifth die along the way
+const GLuint  DEFAULT_STEPS = 60;
+const GLfloat STEP = 1.0f / 60.0f;
+
+typedef std::chrono::steady_clock Clock;
+
+// Nanoseconds since start
+static double since(Clock::time_point start)
+{
+	return std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+}
+
+// A particle as ParticleGenerator stored them before the structure of arrays
+struct Particle {
+	glm::vec2 Position, Velocity;
+	glm::vec4 Color;
+	GLfloat   Life;
+};
+
+// What's compared between the layouts: the live particles' changing fields, in a fixed order
+typedef std::vector<std::vector<GLfloat>> LiveParticles;
+
+static void addLive(LiveParticles &live, GLfloat life, GLfloat x, GLfloat y, GLfloat alpha)
+{
+	std::vector<GLfloat> particle = { life, x, y, alpha };
+	live.push_back(particle);
+}
+
+static void updateAoS(std::vector<Particle> &particles, GLfloat dt)
+{
+	for (Particle &p : particles)
+	{
+		p.Life -= dt; // reduce life
+		if (p.Life > 0.0f)
+		{	// particle is alive, thus update
+			p.Position -= p.Velocity * dt;
+			p.Color.a -= dt * 2.5f;
+		}
+	}
+}
+
+static void updateScalar(ParticleData &p, GLfloat dt)
+{
+	const GLfloat fade = dt * 2.5f;
+	for (GLuint i = 0; i < p.Count; ++i)
+	{
+		p.Life[i] -= dt;
+		p.PositionX[i] -= p.VelocityX[i] * dt;
+		p.PositionY[i] -= p.VelocityY[i] * dt;
+		p.Alpha[i] -= fade;
+	}
+	p.Compact();
+}
+
+static void updateKernel(ParticleData &p, GLfloat dt)
+{
+	UpdateParticles(p, p.Count, dt);
+	p.Compact();
+}
+
+static LiveParticles liveAoS(const std::vector<Particle> &particles)
+{
+	LiveParticles live;
+	for (const Particle &p : particles)
+		if (p.Life > 0.0f)
+			addLive(live, p.Life, p.Position.x, p.Position.y, p.Color.a);
+	std::sort(live.begin(), live.end());
+	return live;
+}
+
+static LiveParticles liveSoA(const ParticleData &p)
+{
+	LiveParticles live;
+	for (GLuint i = 0; i < p.Count; ++i)
+		addLive(live, p.Life[i], p.PositionX[i], p.PositionY[i], p.Alpha[i]);
+	std::sort(live.begin(), live.end());
+	return live;
+}
+
+// Runs steps of update on particles, in place; returns nanoseconds per particle and step
+template <typename Particles, typename Update>
+static double measure(Particles &particles, GLuint size, GLuint steps, Update update)
+{
+	Clock::time_point start = Clock::now();
+	for (GLuint step = 0; step < steps; ++step)
+		update(particles, STEP);
+	return since(start) / (static_cast<double>(size) * steps);
+}
+
+int main(int argc, char *argv[])
+{
+	GLuint steps = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : DEFAULT_STEPS;
+	std::vector<GLuint> sizes;
+	for (int i = 2; i < argc; ++i)
+		sizes.push_back(std::strtoul(argv[i], nullptr, 10));
+	if (sizes.empty())
+		sizes.assign(DEFAULT_SIZES, DEFAULT_SIZES + sizeof(DEFAULT_SIZES) / sizeof(DEFAULT_SIZES[0]));
+
+	std::printf("SIMD kernel width: %u\n", ParticleKernelWidth());
+	std::printf("%10s %14s %14s %14s %12s %10s\n", "particles", "AoS ns/p", "SoA ns/p", "kernel ns/p", "kernel Mp/s", "same");
+	for (GLuint size : sizes)
+	{
+		// The same random particles in both layouts
+		srand(1);
+		std::vector<Particle> aos(size);
+		ParticleData scalar, kernel;
+		scalar.Resize(size);
+		for (GLuint i = 0; i < size; ++i)
+		{
+			Particle &p = aos[i];
+			p.Position = glm::vec2(rand() % 800, rand() % 600);
+			p.Velocity = glm::vec2((rand() % 200 - 100) / 10.0f, (rand() % 200 - 100) / 10.0f);
+			p.Color = glm::vec4((rand() % 100) / 100.0f, (rand() % 100) / 100.0f, (rand() % 100) / 100.0f, 1.0f);
+			p.Life = 0.5f + (rand() % 250) / 100.0f;
+			scalar.PositionX[i] = p.Position.x;
+			scalar.PositionY[i] = p.Position.y;
+			scalar.VelocityX[i] = p.Velocity.x;
+			scalar.VelocityY[i] = p.Velocity.y;
+			scalar.Red[i] = p.Color.r;
+			scalar.Green[i] = p.Color.g;
+			scalar.Blue[i] = p.Color.b;
+			scalar.Alpha[i] = p.Color.a;
+			scalar.Life[i] = p.Life;
+		}
+		scalar.Count = size;
+		kernel = scalar;
+
+		double aosTime = measure(aos, size, steps, updateAoS);
+		double scalarTime = measure(scalar, size, steps, updateScalar);
+		double kernelTime = measure(kernel, size, steps, updateKernel);
+		LiveParticles reference = liveAoS(aos);
+		bool same = liveSoA(scalar) == reference && liveSoA(kernel) == reference;
+		std::printf("%10u %14.3f %14.3f %14.3f %12.0f %10s\n", size, aosTime, scalarTime, kernelTime, 1e3 / kernelTime, same ? "yes" : "MISMATCH");
+	}
+	return 0;
+}
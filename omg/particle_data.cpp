@@ -0,0 +1,103 @@
+/*******************************************************************
+** This code is part of Breakout.
+**
+** Breakout is free software: you can redistribute it and/or modify
+** it under the terms of the CC BY 4.0 license as published by
+** Creative Commons, either version 4 of the License, or (at your
+** option) any later version.
+******************************************************************/
+#include "particle_data.h"
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define PARTICLE_SIMD_WIDTH 8
+#elif defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define PARTICLE_SIMD_WIDTH 4
+#else
+#define PARTICLE_SIMD_WIDTH 1
+#endif
+
+// Storage is padded to a multiple of this so the SIMD kernel never needs a scalar tail loop
+const GLuint PARTICLE_PADDING = 8;
+
+void ParticleData::Resize(GLuint capacity)
+{
+	capacity = (capacity + PARTICLE_PADDING - 1) / PARTICLE_PADDING * PARTICLE_PADDING;
+	this->PositionX.assign(capacity, 0.0f);
+	this->PositionY.assign(capacity, 0.0f);
+	this->VelocityX.assign(capacity, 0.0f);
+	this->VelocityY.assign(capacity, 0.0f);
+	this->Red.assign(capacity, 1.0f);
+	this->Green.assign(capacity, 1.0f);
+	this->Blue.assign(capacity, 1.0f);
+	this->Alpha.assign(capacity, 1.0f);
+	this->Life.assign(capacity, 0.0f);
+	this->Count = 0;
+}
+
+void ParticleData::Move(GLuint from, GLuint to)
+{
+	this->PositionX[to] = this->PositionX[from];
+	this->PositionY[to] = this->PositionY[from];
+	this->VelocityX[to] = this->VelocityX[from];
+	this->VelocityY[to] = this->VelocityY[from];
+	this->Red[to] = this->Red[from];
+	this->Green[to] = this->Green[from];
+	this->Blue[to] = this->Blue[from];
+	this->Alpha[to] = this->Alpha[from];
+	this->Life[to] = this->Life[from];
+}
+
+void UpdateParticles(ParticleData &p, GLuint count, GLfloat dt)
+{
+	GLfloat *life = p.Life.data(), *alpha = p.Alpha.data();
+	GLfloat *px = p.PositionX.data(), *py = p.PositionY.data();
+	const GLfloat *vx = p.VelocityX.data(), *vy = p.VelocityY.data();
+	const GLfloat fade = dt * 2.5f;
+#if PARTICLE_SIMD_WIDTH == 8
+	const __m256 vdt = _mm256_set1_ps(dt), vfade = _mm256_set1_ps(fade);
+	for (GLuint i = 0; i < count; i += 8)
+	{
+		_mm256_storeu_ps(life + i, _mm256_sub_ps(_mm256_loadu_ps(life + i), vdt));
+		_mm256_storeu_ps(px + i, _mm256_sub_ps(_mm256_loadu_ps(px + i), _mm256_mul_ps(_mm256_loadu_ps(vx + i), vdt)));
+		_mm256_storeu_ps(py + i, _mm256_sub_ps(_mm256_loadu_ps(py + i), _mm256_mul_ps(_mm256_loadu_ps(vy + i), vdt)));
+		_mm256_storeu_ps(alpha + i, _mm256_sub_ps(_mm256_loadu_ps(alpha + i), vfade));
+	}
+#elif PARTICLE_SIMD_WIDTH == 4
+	const __m128 vdt = _mm_set1_ps(dt), vfade = _mm_set1_ps(fade);
+	for (GLuint i = 0; i < count; i += 4)
+	{
+		_mm_storeu_ps(life + i, _mm_sub_ps(_mm_loadu_ps(life + i), vdt));
+		_mm_storeu_ps(px + i, _mm_sub_ps(_mm_loadu_ps(px + i), _mm_mul_ps(_mm_loadu_ps(vx + i), vdt)));
+		_mm_storeu_ps(py + i, _mm_sub_ps(_mm_loadu_ps(py + i), _mm_mul_ps(_mm_loadu_ps(vy + i), vdt)));
+		_mm_storeu_ps(alpha + i, _mm_sub_ps(_mm_loadu_ps(alpha + i), vfade));
+	}
+#else
+	for (GLuint i = 0; i < count; ++i)
+	{
+		life[i] -= dt;
+		px[i] -= vx[i] * dt;
+		py[i] -= vy[i] * dt;
+		alpha[i] -= fade;
+	}
+#endif
+}
+
+GLuint ParticleKernelWidth()
+{
+	return PARTICLE_SIMD_WIDTH;
+}
+
+void ParticleData::Compact()
+{
+	// Swap each dead particle with the last live one; order doesn't matter with additive blending
+	GLuint i = 0;
+	while (i < this->Count)
+	{
+		if (this->Life[i] > 0.0f)
+			++i;
+		else
+			this->Move(--this->Count, i);
+	}
+}
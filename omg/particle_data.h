@@ -0,0 +1,41 @@
+/*******************************************************************
+** This code is part of Breakout.
+**
+** Breakout is free software: you can redistribute it and/or modify
+** it under the terms of the CC BY 4.0 license as published by
+** Creative Commons, either version 4 of the License, or (at your
+** option) any later version.
+******************************************************************/
+#ifndef PARTICLE_DATA_H
+#define PARTICLE_DATA_H
+#include <vector>
+
+#include "gl_types.h"
+
+
+// Holds the state of all particles of a generator as a structure of
+// arrays, so the update kernel can stream over each component with SIMD.
+// Live particles are always kept dense in [0, Count).
+struct ParticleData {
+	std::vector<GLfloat> PositionX, PositionY;
+	std::vector<GLfloat> VelocityX, VelocityY;
+	std::vector<GLfloat> Red, Green, Blue, Alpha;
+	std::vector<GLfloat> Life;
+	GLuint Count;
+
+	ParticleData() : Count(0) { }
+	// Allocates storage for (at least) the given number of particles
+	void Resize(GLuint capacity);
+	// Moves particle from index 'from' into slot 'to'
+	void Move(GLuint from, GLuint to);
+	// Removes dead particles, keeping the live ones dense
+	void Compact();
+};
+
+// Integrates 'count' particles (rounded up to the SIMD width, storage is padded).
+// Every particle is updated unconditionally; the ones that die are compacted away afterwards.
+void   UpdateParticles(ParticleData &p, GLuint count, GLfloat dt);
+// Particles the update kernel processes at once (8 with AVX, 4 with SSE, 1 for the scalar fallback)
+GLuint ParticleKernelWidth();
+
+#endif
@@ -8,30 +8,105 @@
 ******************************************************************/
 #include "particle_generator.h"
 
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <functional>
+
+
 ParticleGenerator::ParticleGenerator(Shader shader, Texture2D texture, GLuint amount)
-	: shader(shader), texture(texture), amount(amount)
+	: Dropped(0), SpawnBudget(1000.0f), ViewMin(0.0f), ViewMax(0.0f), ViewMargin(50.0f), Focus(0.0f), FullRateDistance(400.0f),
+	  shader(shader), texture(texture), amount(amount), onGpu(GL_FALSE)
+{
+	this->init();
+}
+
+ParticleGenerator::ParticleGenerator(Shader shader, Shader updateShader, Texture2D texture, GLuint amount)
+	: Dropped(0), SpawnBudget(1000.0f), ViewMin(0.0f), ViewMax(0.0f), ViewMargin(50.0f), Focus(0.0f), FullRateDistance(400.0f),
+	  shader(shader), texture(texture), amount(amount), onGpu(GL_TRUE), updateShader(updateShader)
 {
 	this->init();
+	this->initFeedback();
 }
 
-void ParticleGenerator::Update(GLfloat dt, GameObject &object, GLuint newParticles, glm::vec2 offset)
+void ParticleGenerator::Emit(const ParticleEmitter &emitter)
 {
+	this->emitters.push_back(emitter);
+}
+
+void ParticleGenerator::Update(GLfloat dt)
+{
+	// Throttle each continuous emitter, then scale all of them down together if they exceed the global budget
+	this->rates.resize(this->emitters.size());
+	GLfloat total = 0.0f;
+	for (GLuint i = 0; i < this->emitters.size(); ++i)
+	{
+		this->rates[i] = this->emitters[i].Rate * this->throttle(this->emitters[i]);
+		total += this->rates[i];
+	}
+	GLfloat scale = total > this->SpawnBudget ? this->SpawnBudget / total : 1.0f;
 	// Add new particles 
-	for (GLuint i = 0; i < newParticles; ++i)
+	for (GLuint i = 0; i < this->emitters.size(); ++i)
 	{
-		int unusedParticle = this->firstUnusedParticle();
-		this->respawnParticle(this->particles[unusedParticle], object, offset);
+		const ParticleEmitter &emitter = this->emitters[i];
+		// Fractional spawns are rounded randomly so low rates still spawn on average
+		GLfloat wanted = this->rates[i] * scale * dt;
+		GLuint count = static_cast<GLuint>(wanted);
+		if ((rand() % 1000) / 1000.0f < wanted - count)
+			++count;
+		this->spawn(emitter, count + emitter.Burst);
 	}
-	// Update all particles
-	for (GLuint i = 0; i < this->amount; ++i)
+	this->emitters.clear();
+	if (this->onGpu)
 	{
-		Particle &p = this->particles[i];
-		p.Life -= dt; // reduce life
-		if (p.Life > 0.0f)
-		{	// particle is alive, thus update
-			p.Position -= p.Velocity * dt;
-			p.Color.a -= dt * 2.5;
+		this->updateFeedback(dt);
+		return;
+	}
+	// Update all live particles, then drop the ones that died
+	UpdateParticles(this->particles, this->particles.Count, dt);
+	this->particles.Compact();
+}
+
+GLfloat ParticleGenerator::throttle(const ParticleEmitter &emitter) const
+{
+	// No view configured, spawn everywhere
+	if (this->ViewMax.x <= this->ViewMin.x || this->ViewMax.y <= this->ViewMin.y)
+		return 1.0f;
+	// Off-screen emitters don't spawn at all
+	glm::vec2 p = emitter.Position;
+	if (p.x < this->ViewMin.x - this->ViewMargin || p.x > this->ViewMax.x + this->ViewMargin ||
+		p.y < this->ViewMin.y - this->ViewMargin || p.y > this->ViewMax.y + this->ViewMargin)
+		return 0.0f;
+	// Distant ones spawn at a rate inversely proportional to their distance
+	GLfloat distance = glm::length(p - this->Focus);
+	if (distance <= this->FullRateDistance)
+		return 1.0f;
+	return this->FullRateDistance / distance;
+}
+
+void ParticleGenerator::spawn(const ParticleEmitter &emitter, GLuint count)
+{
+	if (this->onGpu)
+	{	// Queue for upload into free slots; rather drop the spawn than overwrite a live particle
+		GLuint room = this->freeSlots.size() - this->spawns.size();
+		if (count > room)
+		{
+			this->Dropped += count - room;
+			count = room;
+		}
+		for (GLuint i = 0; i < count; ++i)
+			this->spawns.push_back(this->newParticle(emitter));
+		return;
+	}
+	for (GLuint i = 0; i < count; ++i)
+	{
+		GLuint unusedParticle = this->firstUnusedParticle();
+		if (unusedParticle == this->amount)
+		{	// Rather drop the spawn than steal a live particle
+			this->Dropped += count - i;
+			return;
 		}
+		this->respawnParticle(unusedParticle, emitter);
 	}
 }
 
@@ -40,18 +115,35 @@ void ParticleGenerator::Draw()
 {
 	// Use additive blending to give it a 'glow' effect
 	glBlendFunc(GL_SRC_ALPHA, GL_ONE);
-	this->shader.Use();
-	for (Particle particle : this->particles)
+	if (this->onGpu)
 	{
-		if (particle.Life > 0.0f)
-		{
-			this->shader.SetVector2f("offset", particle.Position);
-			this->shader.SetVector4f("color", particle.Color);
-			this->texture.Bind();
-			glBindVertexArray(this->VAO);
-			glDrawArrays(GL_TRIANGLES, 0, 6);
-			glBindVertexArray(0);
-		}
+		this->drawFeedback();
+		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		return;
+	}
+	// Pack all live particles into the instance buffer
+	const ParticleData &p = this->particles;
+	this->instances.resize(p.Count);
+	for (GLuint i = 0; i < p.Count; ++i)
+	{
+		this->instances[i].Offset = glm::vec2(p.PositionX[i], p.PositionY[i]);
+		this->instances[i].Color = glm::vec4(p.Red[i], p.Green[i], p.Blue[i], p.Alpha[i]);
+	}
+	if (!this->instances.empty())
+	{
+		// Orphan last frame's storage so the upload doesn't wait on the previous draw
+		glBindBuffer(GL_ARRAY_BUFFER, this->instanceVBO);
+		glBufferData(GL_ARRAY_BUFFER, this->amount * sizeof(ParticleInstance), NULL, GL_STREAM_DRAW);
+		glBufferSubData(GL_ARRAY_BUFFER, 0, this->instances.size() * sizeof(ParticleInstance), this->instances.data());
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		// And draw them all at once
+		this->shader.Use();
+		this->shader.Set(this->regionUniform, this->texture.Region);
+		glActiveTexture(GL_TEXTURE0);
+		this->texture.Bind();
+		glBindVertexArray(this->VAO);
+		glDrawArraysInstanced(GL_TRIANGLES, 0, 6, this->instances.size());
+		glBindVertexArray(0);
 	}
 	// Don't forget to reset to default blending mode
 	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
@@ -60,7 +152,6 @@ void ParticleGenerator::Draw()
 void ParticleGenerator::init()
 {
 	// Set up mesh and attribute properties
-	GLuint VBO;
 	GLfloat particle_quad[] = {
 		0.0f, 1.0f, 0.0f, 1.0f,
 		1.0f, 0.0f, 1.0f, 0.0f,
@@ -71,50 +162,195 @@ void ParticleGenerator::init()
 		1.0f, 0.0f, 1.0f, 0.0f
 	};
 	glGenVertexArrays(1, &this->VAO);
-	glGenBuffers(1, &VBO);
+	glGenBuffers(1, &this->quadVBO);
 	glBindVertexArray(this->VAO);
 	// Fill mesh buffer
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
+	glBindBuffer(GL_ARRAY_BUFFER, this->quadVBO);
 	glBufferData(GL_ARRAY_BUFFER, sizeof(particle_quad), particle_quad, GL_STATIC_DRAW);
 	// Set mesh attributes
 	glEnableVertexAttribArray(0);
 	glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(GLfloat), (GLvoid*)0);
+	// Set instance attributes (offset and color advance once per particle)
+	glGenBuffers(1, &this->instanceVBO);
+	glBindBuffer(GL_ARRAY_BUFFER, this->instanceVBO);
+	glBufferData(GL_ARRAY_BUFFER, this->amount * sizeof(ParticleInstance), NULL, GL_STREAM_DRAW);
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(ParticleInstance), (GLvoid*)offsetof(ParticleInstance, Offset));
+	glVertexAttribDivisor(1, 1);
+	glEnableVertexAttribArray(2);
+	glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(ParticleInstance), (GLvoid*)offsetof(ParticleInstance, Color));
+	glVertexAttribDivisor(2, 1);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
 	glBindVertexArray(0);
+	this->instances.reserve(this->amount);
+	this->regionUniform = this->shader.GetUniform<glm::vec4>("region");
 
-	// Create this->amount default particle instances
-	for (GLuint i = 0; i < this->amount; ++i)
-		this->particles.push_back(Particle());
+	// Allocate storage for this->amount particles
+	this->particles.Resize(this->amount);
 }
 
-// Stores the index of the last particle used (for quick access to next dead particle)
-GLuint lastUsedParticle = 0;
 GLuint ParticleGenerator::firstUnusedParticle()
 {
-	// First search from last used particle, this will usually return almost instantly
-	for (GLuint i = lastUsedParticle; i < this->amount; ++i) {
-		if (this->particles[i].Life <= 0.0f) {
-			lastUsedParticle = i;
-			return i;
-		}
+	// Live particles are dense, so the first free slot is right behind them
+	if (this->particles.Count < this->amount)
+		return this->particles.Count++;
+	// All particles are taken (note that if it repeatedly hits this case, more particles should be reserved)
+	return this->amount;
+}
+
+ParticleState ParticleGenerator::newParticle(const ParticleEmitter &emitter)
+{
+	GLfloat randomX = ((rand() % 100) - 50) / 50.0f * emitter.Spread;
+	GLfloat randomY = ((rand() % 100) - 50) / 50.0f * emitter.Spread;
+	GLfloat rColor = 0.5 + ((rand() % 100) / 100.0f);
+	GLfloat angle = (rand() % 628) / 100.0f;
+	GLfloat speed = (rand() % 100) / 100.0f * emitter.Speed;
+	ParticleState particle;
+	particle.Position = emitter.Position + glm::vec2(randomX, randomY);
+	particle.Velocity = emitter.Velocity + glm::vec2(cos(angle), sin(angle)) * speed;
+	particle.Color = glm::vec4(emitter.Color * rColor, 1.0f);
+	particle.Life = emitter.Life;
+	return particle;
+}
+
+void ParticleGenerator::respawnParticle(GLuint index, const ParticleEmitter &emitter)
+{
+	ParticleState particle = this->newParticle(emitter);
+	ParticleData &p = this->particles;
+	p.PositionX[index] = particle.Position.x;
+	p.PositionY[index] = particle.Position.y;
+	p.Red[index] = particle.Color.r;
+	p.Green[index] = particle.Color.g;
+	p.Blue[index] = particle.Color.b;
+	p.Alpha[index] = particle.Color.a;
+	p.Life[index] = particle.Life;
+	p.VelocityX[index] = particle.Velocity.x;
+	p.VelocityY[index] = particle.Velocity.y;
+}
+
+void ParticleGenerator::initFeedback()
+{
+	this->dtUniform = this->updateShader.GetUniform<GLfloat>("dt");
+	this->current = this->used = 0;
+	this->clock = 0.0;
+	this->spawns.reserve(this->amount);
+	// Every slot starts out free; in ascending order it already is a min-heap
+	this->freeSlots.resize(this->amount);
+	for (GLuint i = 0; i < this->amount; ++i)
+		this->freeSlots[i] = i;
+	this->deaths.reserve(this->amount);
+	this->live.assign(this->amount, GL_FALSE);
+	// Both state buffers start out filled with dead particles
+	ParticleState dead;
+	dead.Position = glm::vec2(-10000.0f);
+	dead.Velocity = glm::vec2(0.0f);
+	dead.Color = glm::vec4(0.0f);
+	dead.Life = 0.0f;
+	std::vector<ParticleState> initial(this->amount, dead);
+	glGenBuffers(2, this->stateVBO);
+	glGenVertexArrays(2, this->updateVAO);
+	glGenVertexArrays(2, this->drawVAO);
+	for (GLuint i = 0; i < 2; ++i)
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, this->stateVBO[i]);
+		glBufferData(GL_ARRAY_BUFFER, this->amount * sizeof(ParticleState), initial.data(), GL_DYNAMIC_COPY);
+		// Update pass reads every field of a particle as a point
+		glBindVertexArray(this->updateVAO[i]);
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(ParticleState), (GLvoid*)offsetof(ParticleState, Position));
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(ParticleState), (GLvoid*)offsetof(ParticleState, Velocity));
+		glEnableVertexAttribArray(2);
+		glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(ParticleState), (GLvoid*)offsetof(ParticleState, Color));
+		glEnableVertexAttribArray(3);
+		glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, sizeof(ParticleState), (GLvoid*)offsetof(ParticleState, Life));
+		// Draw pass instances the quad, reading offset and color straight from the state buffer
+		glBindVertexArray(this->drawVAO[i]);
+		glBindBuffer(GL_ARRAY_BUFFER, this->quadVBO);
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(GLfloat), (GLvoid*)0);
+		glBindBuffer(GL_ARRAY_BUFFER, this->stateVBO[i]);
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(ParticleState), (GLvoid*)offsetof(ParticleState, Position));
+		glVertexAttribDivisor(1, 1);
+		glEnableVertexAttribArray(2);
+		glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(ParticleState), (GLvoid*)offsetof(ParticleState, Color));
+		glVertexAttribDivisor(2, 1);
 	}
-	// Otherwise, do a linear search
-	for (GLuint i = 0; i < lastUsedParticle; ++i) {
-		if (this->particles[i].Life <= 0.0f) {
-			lastUsedParticle = i;
-			return i;
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void ParticleGenerator::updateFeedback(GLfloat dt)
+{
+	GLuint count = this->spawns.size();
+	if (count > 0)
+	{
+		// Take the lowest free slots (spawn() made sure there are enough); they come off the heap in ascending order
+		std::vector<GLuint> slots(count);
+		for (GLuint i = 0; i < count; ++i)
+		{
+			std::pop_heap(this->freeSlots.begin(), this->freeSlots.end(), std::greater<GLuint>());
+			slots[i] = this->freeSlots.back();
+			this->freeSlots.pop_back();
+			this->live[slots[i]] = GL_TRUE;
+			this->deaths.push_back(std::make_pair(this->clock + this->spawns[i].Life, slots[i]));
+			std::push_heap(this->deaths.begin(), this->deaths.end(), std::greater<std::pair<GLdouble, GLuint>>());
+		}
+		this->used = std::max(this->used, slots.back() + 1);
+		// Upload each run of adjacent slots at once
+		glBindBuffer(GL_ARRAY_BUFFER, this->stateVBO[this->current]);
+		for (GLuint first = 0, last; first < count; first = last)
+		{
+			for (last = first + 1; last < count && slots[last] == slots[last - 1] + 1; ++last)
+				;
+			glBufferSubData(GL_ARRAY_BUFFER, slots[first] * sizeof(ParticleState), (last - first) * sizeof(ParticleState), this->spawns.data() + first);
 		}
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		this->spawns.clear();
+	}
+	if (this->used == 0)
+		return;
+	// Advance all used slots from the current buffer into the other one, without rasterizing anything
+	this->updateShader.Use();
+	this->updateShader.Set(this->dtUniform, dt);
+	glEnable(GL_RASTERIZER_DISCARD);
+	glBindVertexArray(this->updateVAO[this->current]);
+	glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, this->stateVBO[1 - this->current]);
+	glBeginTransformFeedback(GL_POINTS);
+	glDrawArrays(GL_POINTS, 0, this->used);
+	glEndTransformFeedback();
+	glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+	glBindVertexArray(0);
+	glDisable(GL_RASTERIZER_DISCARD);
+	this->current = 1 - this->current;
+	// Free the slots of the particles that died in this update and drop dead slots off the end.
+	// Slots at or past used are never read again before they are respawned: spawns take the
+	// lowest free slots, so every slot between the old and the new used gets a new particle
+	this->clock += dt;
+	while (!this->deaths.empty() && this->deaths.front().first <= this->clock)
+	{
+		std::pop_heap(this->deaths.begin(), this->deaths.end(), std::greater<std::pair<GLdouble, GLuint>>());
+		GLuint slot = this->deaths.back().second;
+		this->deaths.pop_back();
+		this->live[slot] = GL_FALSE;
+		this->freeSlots.push_back(slot);
+		std::push_heap(this->freeSlots.begin(), this->freeSlots.end(), std::greater<GLuint>());
 	}
-	// All particles are taken, override the first one (note that if it repeatedly hits this case, more particles should be reserved)
-	lastUsedParticle = 0;
-	return 0;
+	while (this->used > 0 && !this->live[this->used - 1])
+		--this->used;
 }
 
-void ParticleGenerator::respawnParticle(Particle &particle, GameObject &object, glm::vec2 offset)
+void ParticleGenerator::drawFeedback()
 {
-	GLfloat random = ((rand() % 100) - 50) / 10.0f;
-	GLfloat rColor = 0.5 + ((rand() % 100) / 100.0f);
-	particle.Position = object.Position + random + offset;
-	particle.Color = glm::vec4(rColor, rColor, rColor, 1.0f);
-	particle.Life = 1.0f;
-	particle.Velocity = object.Velocity * 0.1f;
+	if (this->used == 0)
+		return;
+	// Dead particles are parked off-screen with zero alpha by the update shader
+	this->shader.Use();
+	this->shader.Set(this->regionUniform, this->texture.Region);
+	glActiveTexture(GL_TEXTURE0);
+	this->texture.Bind();
+	glBindVertexArray(this->drawVAO[this->current]);
+	glDrawArraysInstanced(GL_TRIANGLES, 0, 6, this->used);
+	glBindVertexArray(0);
 }
\ No newline at end of file
@@ -9,6 +9,7 @@
 ******************************************************************/
 #ifndef PARTICLE_GENERATOR_H
 #define PARTICLE_GENERATOR_H
+#include <utility>
 #include <vector>
 
 #include <GL/glew.h>
@@ -17,44 +18,120 @@
 #include "shader.h"
 #include "texture.h"
 #include "game_object.h"
+#include "particle_data.h"
 
 
-// Represents a single particle and its state
-struct Particle {
+// Describes a source of particles for a single frame. Continuous sources
+// (exhaust) spawn Rate particles per second, one-off effects (debris,
+// splashes) spawn Burst particles at once.
+struct ParticleEmitter {
+	glm::vec2 Position, Velocity;
+	glm::vec3 Color;  // Tint multiplied with each particle's random brightness
+	GLfloat   Rate;   // Continuous spawns per second; the emitter's own budget
+	GLuint    Burst;  // Particles spawned at once this frame
+	GLfloat   Spread; // Random position jitter in pixels
+	GLfloat   Speed;  // Random extra speed in a random direction
+	GLfloat   Life;   // Lifetime of spawned particles in seconds
+
+	ParticleEmitter(glm::vec2 position, GLfloat rate, GLuint burst = 0, glm::vec3 color = glm::vec3(1.0f))
+		: Position(position), Velocity(0.0f), Color(color), Rate(rate), Burst(burst), Spread(5.0f), Speed(0.0f), Life(1.0f) { }
+};
+
+
+// A single particle as laid out in the transform feedback buffers of
+// particle_update.vs; also used to hand freshly spawned particles around
+struct ParticleState {
 	glm::vec2 Position, Velocity;
 	glm::vec4 Color;
-	GLfloat Life;
+	GLfloat   Life;
+};
 
-	Particle() : Position(0.0f), Velocity(0.0f), Color(1.0f), Life(0.0f) { }
+
+// Per-instance data of a live particle as streamed to particle.vs
+struct ParticleInstance {
+	glm::vec2 Offset;
+	glm::vec4 Color;
 };
 
 
 // ParticleGenerator acts as a container for rendering a large number of 
 // particles by repeatedly spawning and updating particles and killing 
-// them after a given amount of time.
+// them after a given amount of time. Any number of emitters share its
+// single particle pool: emitters are queued every frame with Emit() and
+// spawned in Update(), where emitters outside the view are skipped,
+// distant ones are throttled and all continuous emitters together are
+// scaled down to stay within SpawnBudget.
+// Particles are simulated on the CPU, unless the generator is given an
+// update shader: then they're kept in GL buffers and advanced with
+// transform feedback, and the CPU only uploads newly spawned particles.
 class ParticleGenerator
 {
 public:
-	// Constructor
+	// Number of spawns dropped so far because every particle was alive
+	GLuint Dropped;
+	// Maximum continuous spawns per second over all emitters
+	GLfloat SpawnBudget;
+	// Visible area; emitters further than ViewMargin outside of it don't spawn
+	glm::vec2 ViewMin, ViewMax;
+	GLfloat   ViewMargin;
+	// Emitters further than FullRateDistance from Focus spawn at a reduced rate
+	glm::vec2 Focus;
+	GLfloat   FullRateDistance;
+	// Constructor (simulates on the CPU)
 	ParticleGenerator(Shader shader, Texture2D texture, GLuint amount);
-	// Update all particles
-	void Update(GLfloat dt, GameObject &object, GLuint newParticles, glm::vec2 offset = glm::vec2(0.0f, 0.0f));
+	// Constructor (simulates on the GPU with the given transform feedback shader)
+	ParticleGenerator(Shader shader, Shader updateShader, Texture2D texture, GLuint amount);
+	// Queues an emitter for the next Update
+	void Emit(const ParticleEmitter &emitter);
+	// Spawns particles for all queued emitters and updates all particles
+	void Update(GLfloat dt);
 	// Render all particles
 	void Draw();
 private:
 	// State
-	std::vector<Particle> particles;
+	ParticleData particles;
 	GLuint amount;
 	// Render state
 	Shader shader;
 	Texture2D texture;
-	GLuint VAO;
+	Uniform<glm::vec4> regionUniform;
+	GLuint VAO, quadVBO, instanceVBO;
+	// Live particles packed for upload, sized for this->amount so Draw() doesn't allocate
+	std::vector<ParticleInstance> instances;
+	// Emitters queued for the next Update and their spawn rate after throttling
+	std::vector<ParticleEmitter> emitters;
+	std::vector<GLfloat>         rates;
+	// Transform feedback state; stateVBO[current] holds the latest particles.
+	// The CPU knows when each particle dies, so spawns only go into free slots
+	// and only slots below used (one past the highest live one) are simulated
+	GLboolean onGpu;
+	Shader updateShader;
+	Uniform<GLfloat> dtUniform;
+	GLuint stateVBO[2], updateVAO[2], drawVAO[2];
+	GLuint current, used;
+	std::vector<ParticleState> spawns;
+	// Seconds simulated so far, free slots (a min-heap, low slots are reused
+	// first to keep used small) and the live slots by the time they die (also a min-heap)
+	GLdouble clock;
+	std::vector<GLuint> freeSlots;
+	std::vector<std::pair<GLdouble, GLuint>> deaths;
+	std::vector<GLboolean> live;
 	// Initializes buffer and vertex attributes
 	void init();
-	// Returns the first Particle index that's currently unused e.g. Life <= 0.0f or 0 if no particle is currently inactive
+	// Returns the index of an unused particle slot (the end of the live range) or this->amount if the pool is exhausted
 	GLuint firstUnusedParticle();
+	// Creates a new particle from emitter
+	ParticleState newParticle(const ParticleEmitter &emitter);
 	// Respawns particle
-	void respawnParticle(Particle &particle, GameObject &object, glm::vec2 offset = glm::vec2(0.0f, 0.0f));
+	void respawnParticle(GLuint index, const ParticleEmitter &emitter);
+	// Spawns count particles from emitter, counting the ones that don't fit the pool
+	void spawn(const ParticleEmitter &emitter, GLuint count);
+	// Returns the fraction of its rate an emitter may spawn with given its position
+	GLfloat throttle(const ParticleEmitter &emitter) const;
+	// Transform feedback backend counterparts of init/Update/Draw
+	void initFeedback();
+	void updateFeedback(GLfloat dt);
+	void drawFeedback();
 };
 
 #endif
\ No newline at end of file
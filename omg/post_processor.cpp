@@ -8,97 +8,280 @@
 ******************************************************************/
 #include "post_processor.h"
 
+#include <algorithm>
 #include <iostream>
+#include <string>
 
-PostProcessor::PostProcessor(Shader shader, GLuint width, GLuint height)
-	: PostProcessingShader(shader), Texture(), Width(width), Height(height), Confuse(GL_FALSE), Chaos(GL_FALSE), Shake(GL_FALSE)
+#include "resource_manager.h"
+
+// Bits of the effect combination a post_processing variant is compiled for
+const GLuint EFFECT_CHAOS = 1;
+const GLuint EFFECT_CONFUSE = 2;
+const GLuint EFFECT_SHAKE = 4;
+
+PostProcessor::PostProcessor(GLuint width, GLuint height, GLuint samples)
+	: Width(width), Height(height), Confuse(GL_FALSE), Chaos(GL_FALSE), Shake(GL_FALSE),
+	samples(samples), sceneWidth(width), sceneHeight(height), direct(GL_TRUE), processing(GL_FALSE), scene(nullptr)
 {
 	// Initialize renderbuffer/framebuffer object
 	glGenFramebuffers(1, &this->MSFBO);
-	glGenFramebuffers(1, &this->FBO);
 	glGenRenderbuffers(1, &this->RBO);
+	this->initMultisample();
 
-	// Initialize renderbuffer storage with a multisampled color buffer (don't need a depth/stencil buffer)
-	glBindFramebuffer(GL_FRAMEBUFFER, this->MSFBO);
-	glBindRenderbuffer(GL_RENDERBUFFER, this->RBO);
-	glRenderbufferStorageMultisample(GL_RENDERBUFFER, 8, GL_RGB, width, height); // Allocate storage for render buffer object
-	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, this->RBO); // Attach MS render buffer object to framebuffer
-	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-		std::cout << "ERROR::POSTPROCESSOR: Failed to initialize MSFBO" << std::endl;
+	// Initialize render data and the chain: the blur (only run for Shake) and the effect itself
+	this->initRenderData();
+	this->initVariants();
+	this->blurPasses[0] = this->AddPass(ResourceManager::GetShader(ResourceManager::LoadShader("shaders/post_processing.vs", "shaders/post_blur.fs", nullptr,
+		"postprocessing_blur_h", "#define HORIZONTAL\n")), 0.5f);
+	this->blurPasses[1] = this->AddPass(ResourceManager::GetShader(ResourceManager::LoadShader("shaders/post_processing.vs", "shaders/post_blur.fs", nullptr,
+		"postprocessing_blur_v", "#define VERTICAL\n")), 0.5f);
+	this->effectsPass = this->AddPass(this->variants[0].Program);
+}
 
-	// Also initialize the FBO/texture to blit multisampled color-buffer to; used for shader operations (for postprocessing effects)
-	glBindFramebuffer(GL_FRAMEBUFFER, this->FBO);
-	this->Texture.Generate(width, height, NULL);
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, this->Texture.ID, 0); // Attach texture to framebuffer as its color attachment
-	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-		std::cout << "ERROR::POSTPROCESSOR: Failed to initialize FBO" << std::endl;
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+PostProcessor::~PostProcessor()
+{
+	for (RenderTarget *target : this->targets)
+	{
+		glDeleteFramebuffers(1, &target->FBO);
+		glDeleteTextures(1, &target->Texture.ID);
+		delete target;
+	}
+	glDeleteFramebuffers(1, &this->MSFBO);
+	glDeleteRenderbuffers(1, &this->RBO);
+	glDeleteVertexArrays(1, &this->VAO);
+	glDeleteBuffers(1, &this->VBO);
+}
 
-	// Initialize render data and uniforms
-	this->initRenderData();
-	this->PostProcessingShader.SetInteger("scene", 0, GL_TRUE);
-	GLfloat offset = 1.0f / 300.0f;
-	GLfloat offsets[9][2] = {
-		{ -offset,  offset },  // top-left
-		{ 0.0f,    offset },  // top-center
-		{ offset,  offset },  // top-right
-		{ -offset,  0.0f },  // center-left
-		{ 0.0f,    0.0f },  // center-center
-		{ offset,  0.0f },  // center - right
-		{ -offset, -offset },  // bottom-left
-		{ 0.0f,   -offset },  // bottom-center
-		{ offset, -offset }   // bottom-right    
-	};
-	glUniform2fv(glGetUniformLocation(this->PostProcessingShader.ID, "offsets"), 9, (GLfloat*)offsets);
-	GLint edge_kernel[9] = {
-		-1, -1, -1,
-		-1,  8, -1,
-		-1, -1, -1
-	};
-	glUniform1iv(glGetUniformLocation(this->PostProcessingShader.ID, "edge_kernel"), 9, edge_kernel);
-	GLfloat blur_kernel[9] = {
-		1.0 / 16, 2.0 / 16, 1.0 / 16,
-		2.0 / 16, 4.0 / 16, 2.0 / 16,
-		1.0 / 16, 2.0 / 16, 1.0 / 16
-	};
-	glUniform1fv(glGetUniformLocation(this->PostProcessingShader.ID, "blur_kernel"), 9, blur_kernel);
+GLuint PostProcessor::AddPass(Shader shader, GLfloat scale)
+{
+	this->Passes.push_back(this->makePass(shader, scale));
+	return this->Passes.size() - 1;
+}
+
+PostPass PostProcessor::makePass(Shader shader, GLfloat scale) const
+{
+	PostPass pass;
+	pass.Program = shader;
+	pass.Active = GL_FALSE;
+	pass.Scale = scale;
+	pass.Time = shader.GetUniform<GLfloat>("time");
+	pass.TexelSize = shader.GetUniform<glm::vec2>("texelSize");
+	pass.Program.SetInteger("scene", 0, GL_TRUE);
+	return pass;
+}
+
+void PostProcessor::initVariants()
+{
+	// Chaos overrides Confuse, so combinations with both share the Chaos variant
+	for (GLuint effects = 0; effects < 8; ++effects)
+	{
+		if ((effects & EFFECT_CHAOS) && (effects & EFFECT_CONFUSE))
+			continue;
+		std::string name = "postprocessing";
+		std::string defines;
+		if (effects & EFFECT_CHAOS)
+		{
+			name += "_chaos";
+			defines += "#define CHAOS\n";
+		}
+		if (effects & EFFECT_CONFUSE)
+		{
+			name += "_confuse";
+			defines += "#define CONFUSE\n";
+		}
+		if (effects & EFFECT_SHAKE)
+		{
+			name += "_shake";
+			defines += "#define SHAKE\n";
+		}
+		Shader shader = ResourceManager::GetShader(ResourceManager::LoadShader("shaders/post_processing.vs", "shaders/post_processing.fs", nullptr, name, defines.c_str()));
+		this->variants[effects] = this->makePass(shader, 1.0f);
+		if (effects & EFFECT_CHAOS)
+			this->variants[effects | EFFECT_CONFUSE] = this->variants[effects];
+	}
+}
+
+void PostProcessor::SetQuality(GLuint samples, GLfloat resolution)
+{
+	GLuint width = std::max(static_cast<GLuint>(this->Width * resolution), 1u);
+	GLuint height = std::max(static_cast<GLuint>(this->Height * resolution), 1u);
+	if (samples == this->samples && width == this->sceneWidth && height == this->sceneHeight)
+		return;
+	this->samples = samples;
+	this->sceneWidth = width;
+	this->sceneHeight = height;
+	this->initMultisample();
+	// Pooled targets were sized for the old scene; drop them
+	for (GLuint i = 0; i < this->targets.size(); )
+	{
+		RenderTarget *target = this->targets[i];
+		if (!target->InUse)
+		{
+			glDeleteFramebuffers(1, &target->FBO);
+			glDeleteTextures(1, &target->Texture.ID);
+			delete target;
+			this->targets.erase(this->targets.begin() + i);
+		}
+		else
+			++i;
+	}
 }
 
 void PostProcessor::BeginRender()
 {
-	glBindFramebuffer(GL_FRAMEBUFFER, this->MSFBO);
+	// Pick the variant of the effects pass for the switches that are on; it only runs if any is.
+	// The blur of Shake is only visible when it's on its own
+	GLuint effects = (this->Chaos ? EFFECT_CHAOS : 0) | (this->Confuse ? EFFECT_CONFUSE : 0) | (this->Shake ? EFFECT_SHAKE : 0);
+	this->Passes[this->effectsPass] = this->variants[effects];
+	this->Passes[this->effectsPass].Active = effects != 0;
+	this->Passes[this->blurPasses[0]].Active = this->Passes[this->blurPasses[1]].Active = effects == EFFECT_SHAKE;
+	this->processing = GL_FALSE;
+	for (const PostPass &pass : this->Passes)
+		if (pass.Active)
+			this->processing = GL_TRUE;
+	// Nothing to apply: draw the game straight to the (already cleared) screen
+	GLboolean scaled = this->sceneWidth != this->Width || this->sceneHeight != this->Height;
+	this->direct = !this->processing && !scaled && this->samples == 0;
+	if (this->direct)
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		return;
+	}
+	// Otherwise render into the multisampled buffer, or straight into the target the passes read from
+	if (this->samples > 0)
+		glBindFramebuffer(GL_FRAMEBUFFER, this->MSFBO);
+	else
+	{
+		this->scene = this->acquireTarget(this->sceneWidth, this->sceneHeight);
+		glBindFramebuffer(GL_FRAMEBUFFER, this->scene->FBO);
+	}
+	glViewport(0, 0, this->sceneWidth, this->sceneHeight);
 	glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
 	glClear(GL_COLOR_BUFFER_BIT);
 }
 void PostProcessor::EndRender()
 {
-	// Now resolve multisampled color-buffer into intermediate FBO to store to texture
-	glBindFramebuffer(GL_READ_FRAMEBUFFER, this->MSFBO);
-	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, this->FBO);
-	glBlitFramebuffer(0, 0, this->Width, this->Height, 0, 0, this->Width, this->Height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+	if (this->direct)
+		return;
+	glViewport(0, 0, this->Width, this->Height);
+	if (this->samples > 0)
+	{
+		// Now resolve multisampled color-buffer; straight onto the screen if that's all there is to do
+		GLboolean scaled = this->sceneWidth != this->Width || this->sceneHeight != this->Height;
+		if (!this->processing && !scaled)
+		{
+			glBindFramebuffer(GL_READ_FRAMEBUFFER, this->MSFBO);
+			glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+			glBlitFramebuffer(0, 0, this->Width, this->Height, 0, 0, this->Width, this->Height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+			glBindFramebuffer(GL_FRAMEBUFFER, 0);
+			return;
+		}
+		this->scene = this->acquireTarget(this->sceneWidth, this->sceneHeight);
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, this->MSFBO);
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, this->scene->FBO);
+		glBlitFramebuffer(0, 0, this->sceneWidth, this->sceneHeight, 0, 0, this->sceneWidth, this->sceneHeight, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+	}
 	glBindFramebuffer(GL_FRAMEBUFFER, 0); // Binds both READ and WRITE framebuffer to default framebuffer
 }
 
 void PostProcessor::Render(GLfloat time)
 {
-	// Set uniforms/options
-	this->PostProcessingShader.Use();
-	this->PostProcessingShader.SetFloat("time", time);
-	this->PostProcessingShader.SetInteger("confuse", this->Confuse);
-	this->PostProcessingShader.SetInteger("chaos", this->Chaos);
-	this->PostProcessingShader.SetInteger("shake", this->Shake);
-	// Render textured quad
+	if (!this->scene)
+		return;
+	// No passes, only a lower resolution: a filtered blit scales the scene up
+	if (!this->processing)
+	{
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, this->scene->FBO);
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+		glBlitFramebuffer(0, 0, this->sceneWidth, this->sceneHeight, 0, 0, this->Width, this->Height, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		this->releaseTarget(this->scene);
+		this->scene = nullptr;
+		return;
+	}
+	// Each pass renders a textured quad from the previous output at (a fraction of)
+	// the scene's resolution; the last one goes to the screen, scaling it up
+	GLuint last = 0;
+	for (GLuint i = 0; i < this->Passes.size(); ++i)
+		if (this->Passes[i].Active)
+			last = i;
+	RenderTarget *source = this->scene;
 	glActiveTexture(GL_TEXTURE0);
-	this->Texture.Bind();
 	glBindVertexArray(this->VAO);
-	glDrawArrays(GL_TRIANGLES, 0, 6);
+	for (GLuint i = 0; i <= last; ++i)
+	{
+		PostPass &pass = this->Passes[i];
+		if (!pass.Active)
+			continue;
+		GLuint width = this->Width, height = this->Height;
+		RenderTarget *target = nullptr;
+		if (i != last)
+		{
+			width = std::max(static_cast<GLuint>(this->sceneWidth * pass.Scale), 1u);
+			height = std::max(static_cast<GLuint>(this->sceneHeight * pass.Scale), 1u);
+			target = this->acquireTarget(width, height);
+		}
+		glBindFramebuffer(GL_FRAMEBUFFER, target ? target->FBO : 0);
+		glViewport(0, 0, width, height);
+		pass.Program.Use();
+		pass.Program.Set(pass.Time, time);
+		pass.Program.Set(pass.TexelSize, glm::vec2(1.0f / source->Texture.Width, 1.0f / source->Texture.Height));
+		source->Texture.Bind();
+		glDrawArrays(GL_TRIANGLES, 0, 6);
+		// The input can be reused by a later pass now
+		this->releaseTarget(source);
+		source = target;
+	}
 	glBindVertexArray(0);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	this->scene = nullptr;
+}
+
+RenderTarget *PostProcessor::acquireTarget(GLuint width, GLuint height)
+{
+	for (RenderTarget *target : this->targets)
+		if (!target->InUse && target->Texture.Width == width && target->Texture.Height == height)
+		{
+			target->InUse = GL_TRUE;
+			return target;
+		}
+	// None free, add one to the pool
+	RenderTarget *target = new RenderTarget();
+	glGenFramebuffers(1, &target->FBO);
+	glBindFramebuffer(GL_FRAMEBUFFER, target->FBO);
+	target->Texture.Generate(width, height, NULL);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target->Texture.ID, 0); // Attach texture to framebuffer as its color attachment
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		std::cout << "ERROR::POSTPROCESSOR: Failed to initialize render target" << std::endl;
+	target->InUse = GL_TRUE;
+	this->targets.push_back(target);
+	return target;
+}
+
+void PostProcessor::releaseTarget(RenderTarget *target)
+{
+	target->InUse = GL_FALSE;
+}
+
+void PostProcessor::initMultisample()
+{
+	if (this->samples == 0)
+		return;
+	// Initialize renderbuffer storage with a multisampled color buffer (don't need a depth/stencil buffer)
+	GLint maxSamples;
+	glGetIntegerv(GL_MAX_SAMPLES, &maxSamples); // Software rasterizers may support fewer than asked for
+	glBindFramebuffer(GL_FRAMEBUFFER, this->MSFBO);
+	glBindRenderbuffer(GL_RENDERBUFFER, this->RBO);
+	glRenderbufferStorageMultisample(GL_RENDERBUFFER, std::min<GLint>(this->samples, maxSamples), GL_RGB8, this->sceneWidth, this->sceneHeight); // Allocate storage for render buffer object
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, this->RBO); // Attach MS render buffer object to framebuffer
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		std::cout << "ERROR::POSTPROCESSOR: Failed to initialize MSFBO" << std::endl;
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
 void PostProcessor::initRenderData()
 {
 	// Configure VAO/VBO
-	GLuint VBO;
 	GLfloat vertices[] = {
 		// Pos        // Tex
 		-1.0f, -1.0f, 0.0f, 0.0f,
@@ -110,9 +293,9 @@ void PostProcessor::initRenderData()
 		1.0f,  1.0f, 1.0f, 1.0f
 	};
 	glGenVertexArrays(1, &this->VAO);
-	glGenBuffers(1, &VBO);
+	glGenBuffers(1, &this->VBO);
 
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
+	glBindBuffer(GL_ARRAY_BUFFER, this->VBO);
 	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
 
 	glBindVertexArray(this->VAO);
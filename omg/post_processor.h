@@ -8,6 +8,7 @@
 ******************************************************************/
 #ifndef POST_PROCESSOR_H
 #define POST_PROCESSOR_H
+#include <vector>
 
 #include <GL/glew.h>
 #include <glm/glm.hpp>
@@ -17,36 +18,98 @@
 #include "shader.h"
 
 
+// An offscreen color buffer passes read from and render into. Targets
+// are pooled by the PostProcessor and handed out again once released.
+struct RenderTarget {
+	GLuint    FBO;
+	Texture2D Texture;
+	GLboolean InUse;
+};
+
+
+// A single full-screen effect of the chain. It samples the previous
+// pass' output as "scene"; inactive passes are skipped entirely.
+struct PostPass {
+	Shader             Program;
+	GLboolean          Active;
+	// Size of the pass' output relative to the scene (the last pass always renders to the window)
+	GLfloat            Scale;
+	Uniform<GLfloat>   Time;
+	Uniform<glm::vec2> TexelSize; // Size of a texel of the pass input in texture coordinates
+};
+
+
 // PostProcessor hosts all PostProcessing effects for the Breakout
 // Game. It renders the game on a textured quad after which one can
 // enable specific effects by enabling either the Confuse, Chaos or 
-// Shake boolean. 
+// Shake boolean. Each combination of them has its own variant of the
+// post processing shader with only that code compiled in, and the blur
+// of Shake runs as two separable passes at half resolution.
+// Effects run as an ordered chain of passes, each reading the output
+// of the one before it, and the last active pass writes straight to
+// the screen. When no pass is active the game is drawn directly to the
+// default framebuffer, skipping the offscreen copy altogether.
+// The scene can be multisampled and rendered at a lower internal
+// resolution (see SetQuality); it is scaled up to the window by the last
+// pass, or by a filtered blit if there are none.
 // It is required to call BeginRender() before rendering the game
 // and EndRender() after rendering the game for the class to work.
 class PostProcessor
 {
 public:
 	// State
-	Shader PostProcessingShader;
-	Texture2D Texture;
 	GLuint Width, Height;
 	// Options
 	GLboolean Confuse, Chaos, Shake;
-	// Constructor
-	PostProcessor(Shader shader, GLuint width, GLuint height);
+	// The chain, in the order passes are applied
+	std::vector<PostPass> Passes;
+	// Constructor/Destructor
+	PostProcessor(GLuint width, GLuint height, GLuint samples = 8);
+	~PostProcessor();
+	// Appends a pass to the chain and returns its index in Passes
+	GLuint AddPass(Shader shader, GLfloat scale = 1.0f);
 	// Prepares the postprocessor's framebuffer operations before rendering the game
 	void BeginRender();
 	// Should be called after rendering the game, so it stores all the rendered data into a texture object
 	void EndRender();
-	// Renders the PostProcessor texture quad (as a screen-encompassing large sprite)
+	// Runs the active passes (as screen-encompassing large sprites); does nothing if the game was drawn directly
 	void Render(GLfloat time);
+	// Sets the MSAA samples of the scene (0 for none) and its resolution relative to the window
+	void SetQuality(GLuint samples, GLfloat resolution);
+	// Whether the current frame goes through the chain
+	GLboolean Processing() const { return !this->direct; }
 private:
 	// Render state
-	GLuint MSFBO, FBO; // MSFBO = Multisampled FBO. FBO is regular, used for blitting MS color-buffer to texture
+	GLuint MSFBO; // MSFBO = Multisampled FBO, the scene is resolved from it into a pooled target
 	GLuint RBO; // RBO is used for multisampled color buffer
-	GLuint VAO;
+	GLuint VAO, VBO;
+	// Samples of the multisampled buffer (0 if it isn't used) and size the scene is rendered at
+	GLuint samples;
+	GLuint sceneWidth, sceneHeight;
+	// Whether this frame is drawn straight to the default framebuffer, and whether any pass is active
+	GLboolean direct, processing;
+	// Pooled targets, and the one holding the resolved scene this frame
+	std::vector<RenderTarget*> targets;
+	RenderTarget *scene;
+	// The passes blurring the scene for Shake and the one running post_processing.fs
+	GLuint blurPasses[2], effectsPass;
+	// The post_processing variant of each combination of EFFECT_ bits
+	PostPass variants[8];
 	// Initialize quad for rendering postprocessing texture
 	void initRenderData();
+	// Compiles the post_processing variants
+	void initVariants();
+	// Sets up a pass running shader
+	PostPass makePass(Shader shader, GLfloat scale) const;
+	// (Re)allocates the multisampled buffer at the scene size
+	void initMultisample();
+	// Returns a free width x height target from the pool, creating one if there is none
+	RenderTarget *acquireTarget(GLuint width, GLuint height);
+	// Hands a target back to the pool
+	void releaseTarget(RenderTarget *target);
+	// Not copyable, it owns GL objects
+	PostProcessor(const PostProcessor&);
+	PostProcessor &operator=(const PostProcessor&);
 };
 
-#endif
\ No newline at end of file
+#endif
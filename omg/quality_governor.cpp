@@ -0,0 +1,115 @@
+/*******************************************************************
+** This code is part of Breakout.
+**
+** Breakout is free software: you can redistribute it and/or modify
+** it under the terms of the CC BY 4.0 license as published by
+** Creative Commons, either version 4 of the License, or (at your
+** option) any later version.
+******************************************************************/
+#include "quality_governor.h"
+
+#include <algorithm>
+#include <iostream>
+
+// Step down when frames take longer than this much of the target, up when they take less than this much
+const GLfloat QUALITY_DOWNGRADE_LOAD = 1.1f;
+const GLfloat QUALITY_UPGRADE_LOAD = 0.7f;
+// Longest an upgrade waits after being undone repeatedly (in frames)
+const GLuint  QUALITY_MAX_UPGRADE_DELAY = 1920;
+
+QualityGovernor::QualityGovernor(GLfloat targetFrameTime, GLuint tier)
+	: TargetFrameTime(targetFrameTime), Tier(std::min(tier, QUALITY_TIER_COUNT - 1)), cpuTimes(), pending(), frame(0), timing(GL_FALSE),
+	total(0.0f), samples(0), sinceChange(0), upgradeDelay(WINDOW * 2), upgraded(GL_FALSE)
+{
+	glGenQueries(QUERIES, this->queries);
+}
+
+QualityGovernor::~QualityGovernor()
+{
+	glDeleteQueries(QUERIES, this->queries);
+}
+
+void QualityGovernor::BeginFrame()
+{
+	this->frameStart = std::chrono::steady_clock::now();
+	// Restarting a query that is still in flight would throw away its result, so this frame isn't timed instead
+	GLuint slot = this->frame % QUERIES;
+	this->timing = !this->pending[slot];
+	if (this->timing)
+		glBeginQuery(GL_TIME_ELAPSED, this->queries[slot]);
+}
+
+GLboolean QualityGovernor::EndFrame()
+{
+	GLuint slot = this->frame % QUERIES;
+	if (this->timing)
+	{
+		glEndQuery(GL_TIME_ELAPSED);
+		std::chrono::duration<GLfloat> cpuTime = std::chrono::steady_clock::now() - this->frameStart;
+		this->cpuTimes[slot] = cpuTime.count();
+		this->pending[slot] = GL_TRUE;
+	}
+	++this->frame;
+	// Collect the finished queries, oldest first; the GPU finishes them in order, so the first one
+	// it hasn't got to yet ends the search
+	GLboolean changed = GL_FALSE;
+	for (GLuint i = 0; i < QUERIES; ++i)
+	{
+		GLuint oldest = (this->frame + i) % QUERIES;
+		if (!this->pending[oldest])
+			continue;
+		GLint available = 0;
+		glGetQueryObjectiv(this->queries[oldest], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available)
+			break;
+		GLuint64 gpuTime = 0;
+		glGetQueryObjectui64v(this->queries[oldest], GL_QUERY_RESULT, &gpuTime);
+		this->pending[oldest] = GL_FALSE;
+		if (this->record(std::max(this->cpuTimes[oldest], gpuTime * 1e-9f)))
+			changed = GL_TRUE;
+	}
+	return changed;
+}
+
+GLboolean QualityGovernor::record(GLfloat frameTime)
+{
+	this->total += frameTime;
+	++this->samples;
+	++this->sinceChange;
+	if (this->samples < WINDOW)
+		return GL_FALSE;
+	GLfloat average = this->total / this->samples;
+	this->total = 0.0f;
+	this->samples = 0;
+	if (average > this->TargetFrameTime * QUALITY_DOWNGRADE_LOAD && this->Tier > 0)
+	{
+		// Undoing an upgrade right after making it means it was too optimistic: wait longer next time
+		if (this->upgraded && this->sinceChange <= this->upgradeDelay)
+			this->upgradeDelay = std::min(this->upgradeDelay * 2, QUALITY_MAX_UPGRADE_DELAY);
+		this->upgraded = GL_FALSE;
+		this->change(this->Tier - 1, average);
+		return GL_TRUE;
+	}
+	if (average < this->TargetFrameTime * QUALITY_UPGRADE_LOAD && this->Tier + 1 < QUALITY_TIER_COUNT &&
+		this->sinceChange >= this->upgradeDelay)
+	{
+		this->upgraded = GL_TRUE;
+		this->change(this->Tier + 1, average);
+		return GL_TRUE;
+	}
+	// An upgrade that held up resets the delay
+	if (this->upgraded && this->sinceChange > this->upgradeDelay)
+	{
+		this->upgraded = GL_FALSE;
+		this->upgradeDelay = WINDOW * 2;
+	}
+	return GL_FALSE;
+}
+
+void QualityGovernor::change(GLuint tier, GLfloat average)
+{
+	std::cout << "QUALITY: " << QUALITY_TIERS[this->Tier].Name << " -> " << QUALITY_TIERS[tier].Name
+		<< " (frames took " << average * 1000.0f << " ms, target " << this->TargetFrameTime * 1000.0f << " ms)" << std::endl;
+	this->Tier = tier;
+	this->sinceChange = 0;
+}
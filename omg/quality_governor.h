@@ -0,0 +1,85 @@
+/*******************************************************************
+** This code is part of Breakout.
+**
+** Breakout is free software: you can redistribute it and/or modify
+** it under the terms of the CC BY 4.0 license as published by
+** Creative Commons, either version 4 of the License, or (at your
+** option) any later version.
+******************************************************************/
+#ifndef QUALITY_GOVERNOR_H
+#define QUALITY_GOVERNOR_H
+#include <chrono>
+
+#include <GL/glew.h>
+
+
+// Render settings that trade looks for speed, from cheapest to best
+struct QualityTier {
+	const GLchar *Name;
+	GLuint        Samples;      // MSAA samples of the scene (0 = none)
+	GLfloat       Resolution;   // Internal render resolution, relative to the window
+	GLfloat       ParticleRate; // Fraction of the particle spawn budget
+	GLboolean     Effects;      // Whether cosmetic post effects (screen shake) run
+};
+
+const QualityTier QUALITY_TIERS[] = {
+	{ "low",       0, 0.5f,  0.25f, GL_FALSE },
+	{ "medium",    0, 0.75f, 0.5f,  GL_TRUE  },
+	{ "high",      0, 1.0f,  1.0f,  GL_TRUE  },
+	{ "very high", 4, 1.0f,  1.0f,  GL_TRUE  },
+	{ "ultra",     8, 1.0f,  1.0f,  GL_TRUE  }
+};
+const GLuint QUALITY_TIER_COUNT = sizeof(QUALITY_TIERS) / sizeof(QUALITY_TIERS[0]);
+
+
+// QualityGovernor measures how long frames take to render and steps
+// through QUALITY_TIERS to hold a target frame time. A frame costs the
+// longer of its CPU time and its GPU time (read back from timer queries
+// a few frames later, so it never stalls; while the GPU is so far behind
+// that every query is still in flight, frames go unmeasured). Tiers only change once a full
+// window of frames agrees, stepping down above the target and up only
+// well below it; an upgrade that has to be undone soon after makes the
+// next one wait twice as long, so the tier doesn't oscillate.
+class QualityGovernor
+{
+public:
+	// Frame time (in seconds) to hold
+	GLfloat TargetFrameTime;
+	// Index into QUALITY_TIERS of the current tier
+	GLuint  Tier;
+	// Constructor/Destructor
+	QualityGovernor(GLfloat targetFrameTime, GLuint tier = QUALITY_TIER_COUNT - 1);
+	~QualityGovernor();
+	// The settings of the current tier
+	const QualityTier &Current() const { return QUALITY_TIERS[this->Tier]; }
+	// Brackets the work of a frame; EndFrame returns whether the tier changed
+	void      BeginFrame();
+	GLboolean EndFrame();
+private:
+	// Frames averaged before deciding, and timer queries kept in flight
+	static const GLuint WINDOW = 30;
+	static const GLuint QUERIES = 4;
+	// Timer queries in flight and the CPU time of the frame each one measured
+	GLuint    queries[QUERIES];
+	GLfloat   cpuTimes[QUERIES];
+	GLboolean pending[QUERIES];
+	GLuint    frame;
+	// Whether the current frame is being timed (its query wasn't in flight any more)
+	GLboolean timing;
+	std::chrono::steady_clock::time_point frameStart;
+	// Frame times collected since the last change
+	GLfloat   total;
+	GLuint    samples;
+	// Frames since the last change, frames an upgrade has to wait, and whether the last change was an upgrade
+	GLuint    sinceChange, upgradeDelay;
+	GLboolean upgraded;
+	// Adds the cost of a finished frame and changes tier if needed
+	GLboolean record(GLfloat frameTime);
+	// Switches to tier and logs it
+	void      change(GLuint tier, GLfloat average);
+	// Not copyable, it owns GL objects
+	QualityGovernor(const QualityGovernor&);
+	QualityGovernor &operator=(const QualityGovernor&);
+};
+
+#endif
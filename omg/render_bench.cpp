@@ -0,0 +1,192 @@
+/*******************************************************************
+** This code is part of Breakout.
+**
+** Breakout is free software: you can redistribute it and/or modify
+** it under the terms of the CC BY 4.0 license as published by
+** Creative Commons, either version 4 of the License, or (at your
+** option) any later version.
+******************************************************************/
+// Measures the renderer on growing scenes in a hidden window: sprites
+// drawn one call at a time (SpriteRenderer) against batched per texture
+// (SpriteBatch), and full particle pools updated on the CPU against with
+// transform feedback (ParticleGenerator's two backends). It renders into an offscreen framebuffer and waits for
+// the GPU every frame, so the times include the GPU's (or llvmpipe's)
+// work. Needs GL, GLFW and GLEW (see the Makefile).
+// Usage: render_bench [frames] [sprites...]
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "particle_generator.h"
+#include "resource_manager.h"
+#include "sprite_renderer.h"
+#include "sprite_batch.h"
+
+// Scene sizes measured unless given on the command line
+const GLuint DEFAULT_SIZES[] = { 100, 1000, 10000 };
+const GLuint DEFAULT_FRAMES = 20;
+const GLuint SCREEN_WIDTH = 800, SCREEN_HEIGHT = 600;
+// Distinct textures the sprites are spread over (like a level's vehicle kinds)
+const GLuint SPRITE_TEXTURES = 8;
+// Particle pool sizes; particles live PARTICLE_LIFE seconds and are spawned
+// at the rate that keeps the pool full, from 60 Hz frames
+const GLuint  PARTICLE_SIZES[] = { 2000, 20000, 100000 };
+const GLfloat PARTICLE_LIFE = 1.0f;
+const GLfloat PARTICLE_STEP = 1.0f / 60.0f;
+
+typedef std::chrono::steady_clock Clock;
+
+// Milliseconds since start
+static double since(Clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+struct BenchSprite {
+	GLuint    Texture;
+	glm::vec2 Position;
+};
+
+// Draws the sprites frames times with draw; returns milliseconds per frame
+template <typename Draw>
+static double timeFrames(GLuint frames, Draw draw)
+{
+	Clock::time_point start = Clock::now();
+	for (GLuint frame = 0; frame < frames; ++frame)
+	{
+		glClear(GL_COLOR_BUFFER_BIT);
+		draw();
+	}
+	glFinish();
+	return since(start) / frames;
+}
+
+int main(int argc, char *argv[])
+{
+	GLuint frames = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : DEFAULT_FRAMES;
+	std::vector<GLuint> sizes;
+	for (int i = 2; i < argc; ++i)
+		sizes.push_back(std::strtoul(argv[i], nullptr, 10));
+	if (sizes.empty())
+		sizes.assign(DEFAULT_SIZES, DEFAULT_SIZES + sizeof(DEFAULT_SIZES) / sizeof(DEFAULT_SIZES[0]));
+
+	glfwInit();
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+	GLFWwindow *window = glfwCreateWindow(SCREEN_WIDTH, SCREEN_HEIGHT, "render_bench", nullptr, nullptr);
+	if (!window)
+	{
+		std::printf("Could not create a GL 3.3 context\n");
+		return 1;
+	}
+	glfwMakeContextCurrent(window);
+	glewExperimental = GL_TRUE;
+	glewInit();
+	glGetError();
+	std::printf("Renderer: %s\n", glGetString(GL_RENDERER));
+
+	// Render offscreen, so it doesn't matter whether the window is shown
+	GLuint fbo, rbo;
+	glGenFramebuffers(1, &fbo);
+	glGenRenderbuffers(1, &rbo);
+	glBindRenderbuffer(GL_RENDERBUFFER, rbo);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, SCREEN_WIDTH, SCREEN_HEIGHT);
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, rbo);
+	glViewport(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT);
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+	ResourceManager::LoadShader("shaders/vertex.vs", "shaders/fragment.fs", nullptr, "sprite");
+	ResourceManager::LoadShader("shaders/sprite_batch.vs", "shaders/sprite_batch.fs", nullptr, "sprite_batch");
+	ResourceManager::SetProjection(glm::ortho(0.0f, static_cast<GLfloat>(SCREEN_WIDTH), static_cast<GLfloat>(SCREEN_HEIGHT), 0.0f, -1.0f, 1.0f));
+	ResourceManager::GetShader("sprite").Use().SetInteger("sprite", 0);
+	ResourceManager::GetShader("sprite_batch").Use().SetInteger("image", 0);
+	SpriteRenderer renderer(ResourceManager::GetShader("sprite"));
+	SpriteBatch batch(ResourceManager::GetShader("sprite_batch"));
+
+	// Small solid textures, one colour each
+	Texture2D textures[SPRITE_TEXTURES];
+	for (GLuint t = 0; t < SPRITE_TEXTURES; ++t)
+	{
+		std::vector<unsigned char> pixels(16 * 16 * 4, 255);
+		for (GLuint p = 0; p < 16 * 16; ++p)
+			pixels[p * 4] = static_cast<unsigned char>(t * 32);
+		textures[t].Internal_Format = textures[t].Image_Format = GL_RGBA;
+		textures[t].Generate(16, 16, pixels.data());
+	}
+
+	std::printf("%-10s %-22s %14s %12s\n", "sprites", "renderer", "draws/frame", "ms/frame");
+	for (GLuint size : sizes)
+	{
+		srand(1);
+		std::vector<BenchSprite> sprites(size);
+		for (BenchSprite &sprite : sprites)
+		{
+			sprite.Texture = rand() % SPRITE_TEXTURES;
+			sprite.Position = glm::vec2(rand() % SCREEN_WIDTH, rand() % SCREEN_HEIGHT);
+		}
+		// One draw call per sprite
+		double single = timeFrames(frames, [&]() {
+			for (const BenchSprite &sprite : sprites)
+				renderer.DrawSprite(textures[sprite.Texture], sprite.Position, glm::vec2(20, 40));
+		});
+		std::printf("%-10u %-22s %14u %12.2f\n", size, "SpriteRenderer", size, single);
+		// One draw call per run of sprites with the same texture, in submission order and grouped by texture
+		for (GLboolean sorted = GL_FALSE; sorted <= GL_TRUE; ++sorted)
+		{
+			double batched = timeFrames(frames, [&]() {
+				batch.ResetStats();
+				batch.Begin(sorted);
+				for (const BenchSprite &sprite : sprites)
+					batch.DrawSprite(textures[sprite.Texture], sprite.Position, glm::vec2(20, 40));
+				batch.End();
+			});
+			std::printf("%-10u %-22s %14u %12.2f\n", size, sorted ? "SpriteBatch (sorted)" : "SpriteBatch (in order)", batch.DrawCalls, batched);
+		}
+	}
+
+	// Particles: the CPU backend updates and uploads every live particle each
+	// frame, the transform feedback one only uploads the new ones
+	ResourceManager::LoadShader("shaders/particle.vs", "shaders/particle.fs", nullptr, "particle");
+	ResourceManager::GetShader("particle").Use().SetInteger("sprite", 0);
+	const GLchar *varyings[] = { "outPosition", "outVelocity", "outColor", "outLife" };
+	ResourceManager::LoadFeedbackShader("shaders/particle_update.vs", varyings, 4, "particle_update");
+	std::printf("\n%-10s %-22s %14s %12s %12s\n", "particles", "backend", "dropped", "Update ms", "+Draw ms");
+	for (GLuint size : PARTICLE_SIZES)
+	{
+		for (GLboolean onGpu = GL_FALSE; onGpu <= GL_TRUE; ++onGpu)
+		{
+			ParticleGenerator particles = onGpu
+				? ParticleGenerator(ResourceManager::GetShader("particle"), ResourceManager::GetShader("particle_update"), textures[0], size)
+				: ParticleGenerator(ResourceManager::GetShader("particle"), textures[0], size);
+			particles.SpawnBudget = size / PARTICLE_LIFE;
+			ParticleEmitter emitter(glm::vec2(SCREEN_WIDTH / 2, SCREEN_HEIGHT / 2), size / PARTICLE_LIFE);
+			emitter.Life = PARTICLE_LIFE;
+			emitter.Speed = 200.0f;
+			auto update = [&]() {
+				particles.Emit(emitter);
+				particles.Update(PARTICLE_STEP);
+			};
+			// Fill the pool before measuring; the update alone, then with drawing (which is the same work for both)
+			timeFrames(static_cast<GLuint>(PARTICLE_LIFE / PARTICLE_STEP), update);
+			double updateTime = timeFrames(frames, update);
+			double frameTime = timeFrames(frames, [&]() {
+				update();
+				particles.Draw();
+			});
+			std::printf("%-10u %-22s %14u %12.2f %12.2f\n", size, onGpu ? "transform feedback" : "CPU", particles.Dropped, updateTime, frameTime);
+		}
+	}
+	if (GLenum error = glGetError())
+		std::printf("GL error 0x%x\n", error);
+	glfwTerminate();
+	return 0;
+}
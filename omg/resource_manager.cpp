@@ -11,47 +11,468 @@
 #include <iostream>
 #include <sstream>
 #include <fstream>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
 
-#include <SOIL.h>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "baked_texture.h"
+#include "texture_atlas.h"
+#include "thread_pool.h"
 
 // Instantiate static variables
-std::map<std::string, Texture2D>    ResourceManager::Textures;
-std::map<std::string, Shader>       ResourceManager::Shaders;
+std::vector<Texture2D>              ResourceManager::Textures;
+std::vector<Shader>                 ResourceManager::Shaders;
+std::vector<ResourceManager::NamedHandle> ResourceManager::shaderNames;
+std::vector<ResourceManager::NamedHandle> ResourceManager::textureNames;
+GLuint                              ResourceManager::MatricesUBO = 0;
+GLuint                              ResourceManager::BakedTextures = 0;
+GLuint                              ResourceManager::DecodedTextures = 0;
+GLuint                              ResourceManager::ShaderCacheHits = 0;
+GLuint                              ResourceManager::ShaderCacheMisses = 0;
+std::vector<ResourceManager::TextureRequest> ResourceManager::loadQueue;
+ThreadPool                         *ResourceManager::workers = nullptr;
+std::shared_ptr<TextureLoad>        ResourceManager::loading;
+GLuint                              ResourceManager::uploadPBO = 0;
+Texture2D                          *ResourceManager::placeholder = nullptr;
+
+
+ShaderHandle ResourceManager::LoadShader(const GLchar *vShaderFile, const GLchar *fShaderFile, const GLchar *gShaderFile, ResourceName name, const GLchar *defines)
+{
+	ShaderHandle handle = findHandle(shaderNames, name, Shaders.size());
+	if (handle == Shaders.size())
+		Shaders.push_back(Shader());
+	Shaders[handle] = loadShaderFromFile(vShaderFile, fShaderFile, gShaderFile, defines, name.Name);
+	return handle;
+}
 
+ShaderHandle ResourceManager::LoadFeedbackShader(const GLchar *vShaderFile, const GLchar **varyings, GLsizei count, ResourceName name)
+{
+	std::ifstream vertexShaderFile(vShaderFile);
+	std::stringstream vShaderStream;
+	vShaderStream << vertexShaderFile.rdbuf();
+	std::string vertexCode = vShaderStream.str();
+	if (vertexCode.empty())
+		std::cout << "ERROR::SHADER: Failed to read shader file " << vShaderFile << std::endl;
+	ShaderHandle handle = findHandle(shaderNames, name, Shaders.size());
+	if (handle == Shaders.size())
+		Shaders.push_back(Shader());
+	// The captured outputs are part of the linked program, so they're part of the cache key too
+	std::string key = vertexCode;
+	for (GLsizei i = 0; i < count; ++i)
+		key += std::string(1, '\0') + varyings[i];
+	std::string cacheFile = programCacheFile(vShaderFile, name.Name);
+	unsigned long long cacheKey = programCacheKey(key);
+	if (!loadProgramBinary(Shaders[handle], cacheFile, cacheKey))
+	{
+		Shaders[handle].CompileFeedback(vertexCode.c_str(), varyings, count);
+		saveProgramBinary(Shaders[handle], cacheFile, cacheKey);
+	}
+	return handle;
+}
+
+Shader &ResourceManager::GetShader(ResourceName name)
+{
+	ShaderHandle handle = lookupHandle(shaderNames, name);
+	if (handle != NO_HANDLE)
+		return Shaders[handle];
+	std::cout << "ERROR::SHADER: No shader named " << name.Name << std::endl;
+	static Shader missing;
+	return missing;
+}
+
+TextureHandle ResourceManager::LoadTexture(const GLchar *file, GLboolean alpha, ResourceName name)
+{
+	TextureHandle handle = textureSlot(name);
+	Textures[handle] = loadTextureFromFile(file, alpha);
+	return handle;
+}
 
-Shader ResourceManager::LoadShader(const GLchar *vShaderFile, const GLchar *fShaderFile, const GLchar *gShaderFile, std::string name)
+TextureHandle ResourceManager::QueueTexture(const GLchar *file, GLboolean alpha, ResourceName name)
 {
-	Shaders[name] = loadShaderFromFile(vShaderFile, fShaderFile, gShaderFile);
-	return Shaders[name];
+	TextureRequest request = { file, textureSlot(name), alpha, GL_FALSE };
+	loadQueue.push_back(request);
+	return request.Handle;
+}
+
+TextureHandle ResourceManager::AddToAtlas(const GLchar *file, GLboolean alpha, ResourceName name)
+{
+	TextureRequest request = { file, textureSlot(name), alpha, GL_TRUE };
+	loadQueue.push_back(request);
+	return request.Handle;
+}
+
+// State of an asynchronous texture load started by StartLoadingTextures
+struct TextureLoad {
+	// Distinct (file, channels) pairs to decode; fileOf maps every queued request to one of them
+	std::vector<std::pair<std::string, GLuint>> Files;
+	std::vector<GLuint>                         FileOf;
+	// Whether any request for a file is a texture of its own; atlas pages only need level 0
+	std::vector<char>                           Mipmapped;
+	std::vector<std::unique_ptr<TextureImage>>  Sources;
+	std::vector<char>                           Loaded;
+	// Indices of decoded files not yet uploaded, filled by the workers
+	std::deque<GLuint>                          Ready;
+	std::mutex                                  Mutex;
+	std::condition_variable                     Arrived;
+	GLuint                                      Received;
+	// Atlas packing, done once every file arrived; pages are then uploaded one at a time
+	GLuint                                      PageSize;
+	GLboolean                                   Packed;
+	std::vector<AtlasImage>                     Images;
+	std::vector<GLuint>                         ImageRequest;
+	std::vector<Texture2D>                      Pages;
+	GLuint                                      PagesUploaded;
+
+	TextureLoad() : Received(0), PageSize(0), Packed(GL_FALSE), PagesUploaded(0) { }
+};
+
+void ResourceManager::LoadQueuedTextures(GLuint pageSize)
+{
+	StartLoadingTextures(pageSize);
+	while (!UpdateLoading(1.0))
+	{
+		// Nothing left to upload yet, sleep until a worker hands over an image
+		std::unique_lock<std::mutex> lock(loading->Mutex);
+		loading->Arrived.wait(lock, []() { return !loading->Ready.empty() || loading->Received == loading->Files.size(); });
+	}
+}
+
+void ResourceManager::StartLoadingTextures(GLuint pageSize)
+{
+	// Jobs of an earlier load may still be running; they keep their own reference to it
+	loading = std::make_shared<TextureLoad>();
+	GLint maxSize;
+	glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+	loading->PageSize = std::min(pageSize, static_cast<GLuint>(maxSize));
+	// Requests for the same file and channel count share one decode (this also keeps two workers from baking the same file)
+	std::vector<std::pair<std::string, GLuint>> &files = loading->Files;
+	loading->FileOf.resize(loadQueue.size());
+	for (GLuint i = 0; i < loadQueue.size(); ++i)
+	{
+		// Atlas pages are RGBA, so atlas images are always loaded with alpha
+		std::pair<std::string, GLuint> file(loadQueue[i].File, loadQueue[i].Alpha || loadQueue[i].Atlas ? 4 : 3);
+		loading->FileOf[i] = std::find(files.begin(), files.end(), file) - files.begin();
+		if (loading->FileOf[i] == files.size())
+		{
+			files.push_back(file);
+			loading->Mipmapped.push_back(GL_FALSE);
+		}
+		if (!loadQueue[i].Atlas)
+			loading->Mipmapped[loading->FileOf[i]] = GL_TRUE;
+	}
+	// Decode on the workers; each finished image is handed back through the ready queue
+	if (!workers)
+		workers = new ThreadPool();
+	loading->Sources.resize(files.size());
+	loading->Loaded.resize(files.size(), 0);
+	for (GLuint f = 0; f < files.size(); ++f)
+	{
+		loading->Sources[f].reset(new TextureImage());
+		std::shared_ptr<TextureLoad> load = loading;
+		workers->Submit([load, f]() {
+			bool ok = load->Sources[f]->Load(load->Files[f].first.c_str(), load->Files[f].second, load->Mipmapped[f]);
+			std::lock_guard<std::mutex> lock(load->Mutex);
+			load->Loaded[f] = ok;
+			load->Ready.push_back(f);
+			load->Arrived.notify_one();
+		});
+	}
+}
+
+GLboolean ResourceManager::UpdateLoading(GLdouble budget)
+{
+	if (!loading)
+		return GL_TRUE;
+	TextureLoad &load = *loading;
+	std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() +
+		std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<GLdouble>(budget));
+	// Upload stand-alone textures in the order they finish decoding, as many as fit in the budget
+	while (load.Received < load.Files.size() && std::chrono::steady_clock::now() < deadline)
+	{
+		GLuint f;
+		{
+			std::lock_guard<std::mutex> lock(load.Mutex);
+			if (load.Ready.empty())
+				return GL_FALSE;
+			f = load.Ready.front();
+			load.Ready.pop_front();
+		}
+		++load.Received;
+		if (!load.Loaded[f])
+			continue;
+		TextureImage &source = *load.Sources[f];
+		++(source.Baked ? BakedTextures : DecodedTextures);
+		GLboolean inAtlas = GL_FALSE;
+		for (GLuint i = 0; i < loadQueue.size(); ++i)
+		{
+			if (load.FileOf[i] != f)
+				continue;
+			if (loadQueue[i].Atlas)
+			{
+				inAtlas = GL_TRUE;
+				continue;
+			}
+			Texture2D texture;
+			if (source.Channels == 4)
+			{
+				texture.Internal_Format = GL_RGBA;
+				texture.Image_Format = GL_RGBA;
+			}
+			uploadPixels(texture, source.Width, source.Height, source.Pixels, source.LevelOffset(source.Levels), source.Levels, !source.Baked);
+			Textures[loadQueue[i].Handle] = texture;
+		}
+		// Atlas images are still needed for packing, everything else can be released right away
+		if (!inAtlas)
+			load.Sources[f].reset();
+	}
+	if (load.Received < load.Files.size())
+		return GL_FALSE;
+	// Now that every atlas image is known, pack them; images without alpha are made opaque while blitting
+	AtlasPacker packer(load.PageSize);
+	if (!load.Packed)
+	{
+		for (GLuint i = 0; i < loadQueue.size(); ++i)
+		{
+			if (!loadQueue[i].Atlas || !load.Loaded[load.FileOf[i]])
+				continue;
+			const TextureImage &source = *load.Sources[load.FileOf[i]];
+			AtlasImage image;
+			image.Width = source.Width;
+			image.Height = source.Height;
+			image.Pixels = source.Pixels;
+			image.Opaque = !loadQueue[i].Alpha;
+			load.Images.push_back(image);
+			load.ImageRequest.push_back(i);
+		}
+		load.Pages.resize(packer.Pack(load.Images));
+		load.Packed = GL_TRUE;
+	}
+	// Copy the images of one page at a time straight into the upload buffer
+	while (load.PagesUploaded < load.Pages.size())
+	{
+		if (std::chrono::steady_clock::now() >= deadline)
+			return GL_FALSE;
+		GLuint p = load.PagesUploaded++;
+		size_t size = load.PageSize * load.PageSize * 4;
+		auto blitPage = [&](unsigned char *pixels) {
+			memset(pixels, 0, size);
+			for (const AtlasImage &image : load.Images)
+				if (image.Page == p)
+					packer.Blit(pixels, image);
+		};
+		Texture2D &page = load.Pages[p];
+		page.Internal_Format = GL_RGBA;
+		page.Image_Format = GL_RGBA;
+		page.Wrap_S = GL_CLAMP_TO_EDGE;
+		page.Wrap_T = GL_CLAMP_TO_EDGE;
+		unsigned char *staged = mapUploadBuffer(size);
+		if (staged)
+			blitPage(staged);
+		if (!staged || !uploadFromBuffer(page, load.PageSize, load.PageSize, 1))
+		{
+			// The upload buffer couldn't be mapped or lost its contents, so blit the page in client memory instead
+			std::vector<unsigned char> pixels(size);
+			blitPage(pixels.data());
+			page.Generate(load.PageSize, load.PageSize, pixels.data());
+		}
+		std::stringstream name;
+		name << "atlas" << p;
+		Textures[textureSlot(name.str())] = page;
+	}
+	// Every packed texture refers to its page; images too large for a page get a texture of their own (without mips)
+	for (GLuint i = 0; i < load.Images.size(); ++i)
+	{
+		const AtlasImage &image = load.Images[i];
+		Texture2D texture;
+		if (image.Page != NO_ATLAS_PAGE)
+		{
+			glDeleteTextures(1, &texture.ID);
+			texture = load.Pages[image.Page];
+			texture.Width = image.Width;
+			texture.Height = image.Height;
+			texture.Region = glm::vec4(image.X, image.Y, image.X + image.Width, image.Y + image.Height) / static_cast<GLfloat>(load.PageSize);
+		}
+		else
+		{
+			const TextureImage &source = *load.Sources[load.FileOf[load.ImageRequest[i]]];
+			texture.Internal_Format = GL_RGBA;
+			texture.Image_Format = GL_RGBA;
+			uploadPixels(texture, image.Width, image.Height, source.Pixels, source.LevelOffset(source.Levels), source.Levels, !source.Baked);
+		}
+		Textures[loadQueue[load.ImageRequest[i]].Handle] = texture;
+	}
+	loadQueue.clear();
+	loading.reset();
+	return GL_TRUE;
 }
 
-Shader ResourceManager::GetShader(std::string name)
+GLfloat ResourceManager::LoadingProgress()
 {
-	return Shaders[name];
+	if (!loading)
+		return 1.0f;
+	// Every file counts as one step, and so does every atlas page (assume one until packed)
+	GLuint pages = loading->Packed ? loading->Pages.size() : 1;
+	GLuint steps = loading->Files.size() + pages;
+	return static_cast<GLfloat>(loading->Received + loading->PagesUploaded) / steps;
 }
 
-Texture2D ResourceManager::LoadTexture(const GLchar *file, GLboolean alpha, std::string name)
+unsigned char *ResourceManager::mapUploadBuffer(size_t size)
 {
-	Textures[name] = loadTextureFromFile(file, alpha);
-	return Textures[name];
+	if (uploadPBO == 0)
+		glGenBuffers(1, &uploadPBO);
+	// Orphan the previous contents so we don't wait for the last upload to finish reading them
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, uploadPBO);
+	glBufferData(GL_PIXEL_UNPACK_BUFFER, size, NULL, GL_STREAM_DRAW);
+	unsigned char *pixels = static_cast<unsigned char*>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+	// Unbind on failure so callers can fall back to uploading from client memory
+	if (!pixels)
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	return pixels;
 }
 
-Texture2D ResourceManager::GetTexture(std::string name)
+GLboolean ResourceManager::uploadFromBuffer(Texture2D &texture, GLuint width, GLuint height, GLuint levels)
 {
-	return Textures[name];
+	// The buffer's contents are undefined if unmapping fails (e.g. the video memory was lost), so don't upload them
+	GLboolean unmapped = glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+	// With the unpack buffer bound, Generate's data pointer is an offset into it
+	if (unmapped)
+		texture.Generate(width, height, nullptr, levels);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	return unmapped;
+}
+
+void ResourceManager::uploadPixels(Texture2D &texture, GLuint width, GLuint height, const unsigned char *pixels, size_t size, GLuint levels, GLboolean staged)
+{
+	if (staged)
+	{
+		unsigned char *buffer = mapUploadBuffer(size);
+		if (buffer)
+		{
+			memcpy(buffer, pixels, size);
+			if (uploadFromBuffer(texture, width, height, levels))
+				return;
+		}
+	}
+	// Straight from client memory: baked files are already mapped, so staging them would only add a copy
+	texture.Generate(width, height, pixels, levels);
+}
+
+const Texture2D &ResourceManager::GetTexture(ResourceName name)
+{
+	TextureHandle handle = lookupHandle(textureNames, name);
+	return handle != NO_HANDLE ? Textures[handle] : placeholderTexture();
+}
+
+const Texture2D &ResourceManager::placeholderTexture()
+{
+	// A single white texel
+	if (!placeholder)
+	{
+		const unsigned char white[] = { 255, 255, 255, 255 };
+		placeholder = new Texture2D();
+		placeholder->Internal_Format = GL_RGBA;
+		placeholder->Image_Format = GL_RGBA;
+		placeholder->Generate(1, 1, white);
+	}
+	return *placeholder;
+}
+
+TextureHandle ResourceManager::textureSlot(ResourceName name)
+{
+	TextureHandle handle = findHandle(textureNames, name, Textures.size());
+	if (handle == Textures.size())
+		Textures.push_back(placeholderTexture());
+	return handle;
+}
+
+std::vector<ResourceManager::NamedHandle>::const_iterator ResourceManager::findName(const std::vector<NamedHandle> &names, ResourceName name)
+{
+	// Ordered by hash; names only order (and tell apart) entries whose hashes collide
+	return std::lower_bound(names.begin(), names.end(), name, [](const NamedHandle &entry, const ResourceName &name) {
+		return entry.Hash < name.Hash || (entry.Hash == name.Hash && strcmp(entry.Name.c_str(), name.Name) < 0);
+	});
+}
+
+GLuint ResourceManager::findHandle(std::vector<NamedHandle> &names, ResourceName name, GLuint count)
+{
+	std::vector<NamedHandle>::const_iterator it = findName(names, name);
+	if (it != names.end() && it->Hash == name.Hash && it->Name == name.Name)
+		return it->Handle;
+	NamedHandle entry = { name.Hash, name.Name, count };
+	names.insert(it, entry);
+	return count;
+}
+
+GLuint ResourceManager::lookupHandle(const std::vector<NamedHandle> &names, ResourceName name)
+{
+	std::vector<NamedHandle>::const_iterator it = findName(names, name);
+	return it != names.end() && it->Hash == name.Hash && it->Name == name.Name ? it->Handle : NO_HANDLE;
+}
+
+void ResourceManager::SetProjection(const glm::mat4 &projection)
+{
+	if (MatricesUBO == 0)
+	{
+		glGenBuffers(1, &MatricesUBO);
+		glBindBuffer(GL_UNIFORM_BUFFER, MatricesUBO);
+		glBufferData(GL_UNIFORM_BUFFER, sizeof(glm::mat4), NULL, GL_STATIC_DRAW);
+		glBindBufferBase(GL_UNIFORM_BUFFER, MATRICES_BINDING, MatricesUBO);
+	}
+	glBindBuffer(GL_UNIFORM_BUFFER, MatricesUBO);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(glm::mat4), glm::value_ptr(projection));
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
 }
 
 void ResourceManager::Clear()
 {
 	// (Properly) delete all shaders	
-	for (auto iter : Shaders)
-		glDeleteProgram(iter.second.ID);
+	for (Shader &shader : Shaders)
+		glDeleteProgram(shader.ID);
 	// (Properly) delete all textures
-	for (auto iter : Textures)
-		glDeleteTextures(1, &iter.second.ID);
+	for (Texture2D &texture : Textures)
+		glDeleteTextures(1, &texture.ID);
+	Shaders.clear();
+	Textures.clear();
+	shaderNames.clear();
+	textureNames.clear();
+	// Stop the texture workers, then drop whatever they were loading
+	delete workers;
+	workers = nullptr;
+	loading.reset();
+	if (uploadPBO != 0)
+		glDeleteBuffers(1, &uploadPBO);
+	uploadPBO = 0;
+	if (placeholder)
+		glDeleteTextures(1, &placeholder->ID);
+	delete placeholder;
+	placeholder = nullptr;
+	// Delete the shared projection buffer
+	if (MatricesUBO != 0)
+		glDeleteBuffers(1, &MatricesUBO);
+	MatricesUBO = 0;
+}
+
+// Inserts defines right after the #version line, which has to stay first
+static void insertDefines(std::string &code, const GLchar *defines)
+{
+	if (defines == nullptr || code.empty())
+		return;
+	size_t position = 0;
+	if (code.compare(0, 8, "#version") == 0)
+	{
+		size_t end = code.find('\n');
+		position = end == std::string::npos ? code.size() : end + 1;
+	}
+	code.insert(position, defines);
 }
 
-Shader ResourceManager::loadShaderFromFile(const GLchar *vShaderFile, const GLchar *fShaderFile, const GLchar *gShaderFile)
+Shader ResourceManager::loadShaderFromFile(const GLchar *vShaderFile, const GLchar *fShaderFile, const GLchar *gShaderFile, const GLchar *defines, const GLchar *name)
 {
 	// 1. Retrieve the vertex/fragment source code from filePath
 	std::string vertexCode;
@@ -81,23 +502,101 @@ Shader ResourceManager::loadShaderFromFile(const GLchar *vShaderFile, const GLch
 			geometryShaderFile.close();
 			geometryCode = gShaderStream.str();
 		}
-		std::cout << "Yo!\n";
-		std::cout << vertexCode << std::endl;
-		std::cout << fragmentCode << std::endl;
 	}
 	catch (std::exception e)
 	{
 		std::cout << "ERROR::SHADER: Failed to read shader files" << std::endl;
 	}
+	// Specialize every stage the same way; the defines end up in the cache key along with the rest of the source
+	insertDefines(vertexCode, defines);
+	insertDefines(fragmentCode, defines);
+	insertDefines(geometryCode, defines);
 	const GLchar *vShaderCode = vertexCode.c_str();
 	const GLchar *fShaderCode = fragmentCode.c_str();
 	const GLchar *gShaderCode = geometryCode.c_str();
-	// 2. Now create shader object from source code
+	// 2. Now create shader object, from the program cache if it was built from the same sources before
 	Shader shader;
-	shader.Compile(vShaderCode, fShaderCode, gShaderFile != nullptr ? gShaderCode : nullptr);
+	std::string cacheFile = programCacheFile(vShaderFile, name);
+	unsigned long long cacheKey = programCacheKey(vertexCode + '\0' + fragmentCode + '\0' + geometryCode);
+	if (!loadProgramBinary(shader, cacheFile, cacheKey))
+	{
+		shader.Compile(vShaderCode, fShaderCode, gShaderFile != nullptr ? gShaderCode : nullptr);
+		saveProgramBinary(shader, cacheFile, cacheKey);
+	}
 	return shader;
 }
 
+// Header of a cached program binary, followed by Length bytes of binary
+struct ProgramCacheHeader {
+	char               Magic[4]; // "PBIN"
+	GLuint             Format, Length;
+	unsigned long long Key;      // programCacheKey of the sources it was built from
+};
+
+std::string ResourceManager::programCacheFile(const GLchar *vShaderFile, const GLchar *name)
+{
+	// Cached programs live next to the vertex shader
+	std::string directory(vShaderFile);
+	size_t slash = directory.find_last_of("/\\");
+	directory = slash == std::string::npos ? "" : directory.substr(0, slash + 1);
+	return directory + name + ".program";
+}
+
+unsigned long long ResourceManager::programCacheKey(const std::string &sources)
+{
+	// Programs are keyed by their sources and the driver that built them; a new driver simply misses
+	std::string key = sources;
+	const GLubyte *strings[] = { glGetString(GL_VENDOR), glGetString(GL_RENDERER), glGetString(GL_VERSION) };
+	for (const GLubyte *string : strings)
+		key += std::string(1, '\0') + (string ? reinterpret_cast<const char*>(string) : "");
+	// 64 bit FNV-1a
+	unsigned long long hash = 14695981039346656037ull;
+	for (char c : key)
+		hash = (hash ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+	return hash;
+}
+
+GLboolean ResourceManager::loadProgramBinary(Shader &shader, const std::string &cacheFile, unsigned long long key)
+{
+	if (!GLEW_ARB_get_program_binary)
+		return GL_FALSE;
+	std::ifstream file(cacheFile, std::ios::binary | std::ios::ate);
+	std::streamoff size = file ? static_cast<std::streamoff>(file.tellg()) : 0;
+	file.seekg(0);
+	ProgramCacheHeader header;
+	std::vector<char> binary;
+	// A truncated or corrupt file must not make us allocate (or read) more than it holds
+	if (file.read(reinterpret_cast<char*>(&header), sizeof(header)) && memcmp(header.Magic, "PBIN", 4) == 0 &&
+		header.Key == key && header.Length == size - static_cast<std::streamoff>(sizeof(header)))
+	{
+		binary.resize(header.Length);
+		if (file.read(binary.data(), binary.size()) && shader.LoadBinary(header.Format, binary.data(), binary.size()))
+		{
+			++ShaderCacheHits;
+			return GL_TRUE;
+		}
+	}
+	++ShaderCacheMisses;
+	return GL_FALSE;
+}
+
+void ResourceManager::saveProgramBinary(const Shader &shader, const std::string &cacheFile, unsigned long long key)
+{
+	if (!GLEW_ARB_get_program_binary)
+		return;
+	ProgramCacheHeader header = {};
+	std::vector<char> binary;
+	shader.GetBinary(header.Format, binary);
+	if (binary.empty())
+		return;
+	memcpy(header.Magic, "PBIN", 4);
+	header.Length = binary.size();
+	header.Key = key;
+	std::ofstream file(cacheFile, std::ios::binary);
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.write(binary.data(), binary.size());
+}
+
 Texture2D ResourceManager::loadTextureFromFile(const GLchar *file, GLboolean alpha)
 {
 	// Create Texture object
@@ -107,12 +606,12 @@ Texture2D ResourceManager::loadTextureFromFile(const GLchar *file, GLboolean alp
 		texture.Internal_Format = GL_RGBA;
 		texture.Image_Format = GL_RGBA;
 	}
-	// Load image
-	int width, height;
-	unsigned char* image = SOIL_load_image(file, &width, &height, 0, texture.Image_Format == GL_RGBA ? SOIL_LOAD_RGBA : SOIL_LOAD_RGB);
-	// Now generate texture
-	texture.Generate(width, height, image);
-	// And finally free image data
-	SOIL_free_image_data(image);
+	// Load image, from its baked version if there is one (SOIL decodes it otherwise)
+	TextureImage image;
+	if (!image.Load(file, alpha ? 4 : 3))
+		return texture;
+	++(image.Baked ? BakedTextures : DecodedTextures);
+	// Now generate texture straight from the mapped (or decoded) texels
+	texture.Generate(image.Width, image.Height, image.Pixels, image.Levels);
 	return texture;
 }
\ No newline at end of file
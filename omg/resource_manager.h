@@ -9,43 +9,123 @@
 #ifndef RESOURCE_MANAGER_H
 #define RESOURCE_MANAGER_H
 
-#include <map>
+#include <memory>
 #include <string>
+#include <vector>
 
 #include <GL/glew.h>
+#include <glm/glm.hpp>
 
 #include "texture.h"
 #include "shader.h"
+#include "resource_name.h"
+
+class ThreadPool;
+struct TextureLoad;
+
+
+// Handles index the flat resource arrays of ResourceManager. They are
+// returned when a resource is loaded (or queued) and stay valid until Clear().
+typedef GLuint TextureHandle;
+typedef GLuint ShaderHandle;
+// Returned by name lookups that found nothing
+const GLuint NO_HANDLE = 0xFFFFFFFF;
 
 
 // A static singleton ResourceManager class that hosts several
 // functions to load Textures and Shaders. Each loaded texture
-// and/or shader is also stored for future reference by string
-// handles. All functions and resources are static and no 
+// and/or shader is also stored for future reference, by the
+// integer handle returned when loading it or by its name.
+// All functions and resources are static and no 
 // public constructor is defined.
 class ResourceManager
 {
 public:
-	// Resource storage
-	static std::map<std::string, Shader>    Shaders;
-	static std::map<std::string, Texture2D> Textures;
-	// Loads (and generates) a shader program from file loading vertex, fragment (and geometry) shader's source code. If gShaderFile is not nullptr, it also loads a geometry shader
-	static Shader   LoadShader(const GLchar *vShaderFile, const GLchar *fShaderFile, const GLchar *gShaderFile, std::string name);
-	// Retrieves a stored sader
-	static Shader   GetShader(std::string name);
+	// Resource storage, indexed by handle
+	static std::vector<Shader>              Shaders;
+	static std::vector<Texture2D>           Textures;
+	// Uniform buffer backing the "Matrices" block shared by all shaders
+	static GLuint                           MatricesUBO;
+	// Number of textures loaded from baked files and decoded from their source images
+	static GLuint                           BakedTextures, DecodedTextures;
+	// Number of shader programs loaded from the program cache and compiled from source
+	static GLuint                           ShaderCacheHits, ShaderCacheMisses;
+	// Loads (and generates) a shader program from file loading vertex, fragment (and geometry) shader's source code. If gShaderFile is not nullptr, it also loads a geometry shader.
+	// If defines is not nullptr, it is inserted after the #version line of each stage (e.g. "#define SHAKE\n") to build a specialized variant
+	static ShaderHandle  LoadShader(const GLchar *vShaderFile, const GLchar *fShaderFile, const GLchar *gShaderFile, ResourceName name, const GLchar *defines = nullptr);
+	// Loads (and generates) a transform feedback program from a vertex shader file, capturing the given outputs
+	static ShaderHandle  LoadFeedbackShader(const GLchar *vShaderFile, const GLchar **varyings, GLsizei count, ResourceName name);
+	// Retrieves a stored shader
+	static Shader       &GetShader(ShaderHandle handle) { return Shaders[handle]; }
+	static Shader       &GetShader(ResourceName name);
 	// Loads (and generates) a texture from file
-	static Texture2D LoadTexture(const GLchar *file, GLboolean alpha, std::string name);
-	// Retrieves a stored texture
-	static Texture2D GetTexture(std::string name);
+	static TextureHandle LoadTexture(const GLchar *file, GLboolean alpha, ResourceName name);
+	// Queues a texture to be loaded by LoadQueuedTextures; its handle refers to the placeholder until then
+	static TextureHandle QueueTexture(const GLchar *file, GLboolean alpha, ResourceName name);
+	// Queues a texture to be packed into an atlas page by LoadQueuedTextures instead of getting its own GL texture
+	static TextureHandle AddToAtlas(const GLchar *file, GLboolean alpha, ResourceName name);
+	// Decodes all queued textures concurrently on the worker threads, uploading each one on this (the GL) thread
+	// as soon as it is ready. Atlas textures are then packed into as few pages as possible; afterwards GetTexture
+	// returns their page and region. Blocks until everything is loaded
+	static void      LoadQueuedTextures(GLuint pageSize = 2048);
+	// Starts loading the queued textures like LoadQueuedTextures, but returns right away
+	static void      StartLoadingTextures(GLuint pageSize = 2048);
+	// Uploads decoded textures (through a pixel buffer) for at most budget seconds; returns true once all are loaded
+	static GLboolean UpdateLoading(GLdouble budget);
+	// Fraction (0 to 1) of the started load that is done
+	static GLfloat   LoadingProgress();
+	// Retrieves a stored texture; a 1x1 white placeholder while it isn't loaded (yet)
+	static const Texture2D &GetTexture(TextureHandle handle) { return Textures[handle]; }
+	static const Texture2D &GetTexture(ResourceName name);
+	// Uploads the projection matrix to the uniform buffer every shader reads it from
+	static void      SetProjection(const glm::mat4 &projection);
 	// Properly de-allocates all loaded resources
 	static void      Clear();
 private:
 	// Private constructor, that is we do not want any actual resource manager objects. Its members and functions should be publicly available (static).
 	ResourceManager() { }
-	// Loads and generates a shader from file
-	static Shader    loadShaderFromFile(const GLchar *vShaderFile, const GLchar *fShaderFile, const GLchar *gShaderFile = nullptr);
+	// Loads and generates a shader from file; name picks its file in the program cache
+	static Shader    loadShaderFromFile(const GLchar *vShaderFile, const GLchar *fShaderFile, const GLchar *gShaderFile, const GLchar *defines, const GLchar *name);
+	// Path of the cached binary of the program name; each program has one file, overwritten when it is rebuilt
+	static std::string programCacheFile(const GLchar *vShaderFile, const GLchar *name);
+	// Hash of the given sources and the current driver, stored with a cached binary to tell whether it is still valid
+	static unsigned long long programCacheKey(const std::string &sources);
+	// Creates shader from a cached program binary; false (a cache miss) if there is none, it was built from
+	// other sources (key) or it is truncated, or the driver rejects it
+	static GLboolean loadProgramBinary(Shader &shader, const std::string &cacheFile, unsigned long long key);
+	// Stores the binary of a freshly linked program in the cache
+	static void      saveProgramBinary(const Shader &shader, const std::string &cacheFile, unsigned long long key);
 	// Loads a single texture from file
 	static Texture2D loadTextureFromFile(const GLchar *file, GLboolean alpha);
+	// Names of the shaders and textures with their hashes and handles, sorted by hash (then name)
+	struct NamedHandle { GLuint Hash; std::string Name; GLuint Handle; };
+	static std::vector<NamedHandle> shaderNames, textureNames;
+	// Returns where name is or belongs in names
+	static std::vector<NamedHandle>::const_iterator findName(const std::vector<NamedHandle> &names, ResourceName name);
+	// Returns the handle registered for name in names, registering the next free handle (count) if there is none
+	static GLuint    findHandle(std::vector<NamedHandle> &names, ResourceName name, GLuint count);
+	// Returns the handle registered for name in names, or NO_HANDLE
+	static GLuint    lookupHandle(const std::vector<NamedHandle> &names, ResourceName name);
+	// Handle of the texture name, added (holding the placeholder) if it is new
+	static TextureHandle textureSlot(ResourceName name);
+	// Textures waiting for LoadQueuedTextures
+	struct TextureRequest { std::string File; TextureHandle Handle; GLboolean Alpha, Atlas; };
+	static std::vector<TextureRequest> loadQueue;
+	// Workers decoding textures, started on first use
+	static ThreadPool *workers;
+	// Texture load in progress, if any; the workers' jobs hold their own reference so a restart can't free it under them
+	static std::shared_ptr<TextureLoad> loading;
+	// Pixel unpack buffer texels are staged in for upload
+	static GLuint uploadPBO;
+	// What GetTexture returns for textures that aren't loaded, created on first use
+	static Texture2D *placeholder;
+	static const Texture2D &placeholderTexture();
+	// Orphans and maps the upload buffer with room for size bytes, or unbinds it and returns nullptr
+	static unsigned char *mapUploadBuffer(size_t size);
+	// Unmaps the upload buffer and generates texture from its contents; GL_FALSE if they were lost
+	static GLboolean uploadFromBuffer(Texture2D &texture, GLuint width, GLuint height, GLuint levels);
+	// Generates texture from size bytes of pixels, staged through the upload buffer if staged is set
+	static void      uploadPixels(Texture2D &texture, GLuint width, GLuint height, const unsigned char *pixels, size_t size, GLuint levels, GLboolean staged);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,37 @@
+/*******************************************************************
+** This code is part of Breakout.
+**
+** Breakout is free software: you can redistribute it and/or modify
+** it under the terms of the CC BY 4.0 license as published by
+** Creative Commons, either version 4 of the License, or (at your
+** option) any later version.
+******************************************************************/
+#ifndef RESOURCE_NAME_H
+#define RESOURCE_NAME_H
+
+#include <string>
+
+#include "gl_types.h"
+
+
+// ResourceName identifies a resource by its name and the FNV-1a hash of it;
+// lookups compare hashes and only compare the names when the hashes match.
+// Names known up front are declared as constexpr ResourceName constants so
+// the compiler computes their hash; only names built at run time (e.g. from
+// a std::string) are hashed when the lookup is made.
+struct ResourceName {
+	GLuint        Hash;
+	const GLchar *Name;
+
+	constexpr ResourceName(const GLchar *name) : Hash(2166136261u), Name(name)
+	{
+		for (const GLchar *c = name; *c; ++c)
+			Hash = (Hash ^ static_cast<unsigned char>(*c)) * 16777619u;
+	}
+	ResourceName(const std::string &name) : ResourceName(name.c_str()) { }
+};
+
+// Fails to compile unless the compiler can evaluate the hash
+static_assert(ResourceName("rcar").Hash == 0x76481ff1u, "ResourceName must hash at compile time");
+
+#endif
@@ -43,6 +43,8 @@ void Shader::Compile(const GLchar* vertexSource, const GLchar* fragmentSource, c
 	glAttachShader(this->ID, sFragment);
 	if (geometrySource != nullptr)
 		glAttachShader(this->ID, gShader);
+	if (GLEW_ARB_get_program_binary)
+		glProgramParameteri(this->ID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
 	glLinkProgram(this->ID);
 	checkCompileErrors(this->ID, "PROGRAM");
 	// Delete the shaders as they're linked into our program now and no longer necessery
@@ -50,61 +52,173 @@ void Shader::Compile(const GLchar* vertexSource, const GLchar* fragmentSource, c
 	glDeleteShader(sFragment);
 	if (geometrySource != nullptr)
 		glDeleteShader(gShader);
+	this->cacheUniforms();
+}
+
+void Shader::CompileFeedback(const GLchar *vertexSource, const GLchar **varyings, GLsizei count)
+{
+	GLuint sVertex;
+	// Vertex Shader
+	sVertex = glCreateShader(GL_VERTEX_SHADER);
+	glShaderSource(sVertex, 1, &vertexSource, NULL);
+	glCompileShader(sVertex);
+	checkCompileErrors(sVertex, "VERTEX");
+	// Shader Program; the captured outputs have to be declared before linking
+	this->ID = glCreateProgram();
+	glAttachShader(this->ID, sVertex);
+	glTransformFeedbackVaryings(this->ID, count, varyings, GL_INTERLEAVED_ATTRIBS);
+	if (GLEW_ARB_get_program_binary)
+		glProgramParameteri(this->ID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	glLinkProgram(this->ID);
+	checkCompileErrors(this->ID, "PROGRAM");
+	glDeleteShader(sVertex);
+	this->cacheUniforms();
+}
+
+GLboolean Shader::LoadBinary(GLenum format, const void *binary, GLsizei length)
+{
+	this->ID = glCreateProgram();
+	glProgramBinary(this->ID, format, binary, length);
+	// A binary from another driver version fails to link, the caller then compiles from source
+	GLint success;
+	glGetProgramiv(this->ID, GL_LINK_STATUS, &success);
+	if (!success)
+	{
+		glDeleteProgram(this->ID);
+		this->ID = 0;
+		return GL_FALSE;
+	}
+	this->cacheUniforms();
+	return GL_TRUE;
+}
+
+void Shader::GetBinary(GLenum &format, std::vector<char> &binary) const
+{
+	GLint length = 0;
+	glGetProgramiv(this->ID, GL_PROGRAM_BINARY_LENGTH, &length);
+	binary.resize(length);
+	if (length > 0)
+		glGetProgramBinary(this->ID, length, NULL, &format, binary.data());
+}
+
+void Shader::cacheUniforms()
+{
+	this->uniforms = std::make_shared<std::unordered_map<std::string, GLint>>();
+	GLint count = 0;
+	glGetProgramiv(this->ID, GL_ACTIVE_UNIFORMS, &count);
+	for (GLint i = 0; i < count; ++i)
+	{
+		GLchar name[256];
+		GLsizei length;
+		GLint size;
+		GLenum type;
+		glGetActiveUniform(this->ID, i, sizeof(name), &length, &size, &type, name);
+		GLint location = glGetUniformLocation(this->ID, name);
+		if (location < 0)
+			continue; // Member of a uniform block
+		(*this->uniforms)[name] = location;
+		// Arrays are reported as "name[0]", also make them available by their plain name
+		std::string plain(name, length);
+		if (size > 1 && plain.size() > 3 && plain.compare(plain.size() - 3, 3, "[0]") == 0)
+			(*this->uniforms)[plain.substr(0, plain.size() - 3)] = location;
+	}
+	// Hook up the shared projection block, if this program uses it
+	GLuint matrices = glGetUniformBlockIndex(this->ID, "Matrices");
+	if (matrices != GL_INVALID_INDEX)
+		glUniformBlockBinding(this->ID, matrices, MATRICES_BINDING);
+}
+
+GLint Shader::GetUniformLocation(const GLchar *name) const
+{
+	if (!this->uniforms)
+		return glGetUniformLocation(this->ID, name);
+	auto it = this->uniforms->find(name);
+	if (it != this->uniforms->end())
+		return it->second;
+	// Not an active uniform as such (e.g. a specific array element); ask the driver once and remember
+	GLint location = glGetUniformLocation(this->ID, name);
+	(*this->uniforms)[name] = location;
+	return location;
 }
 
 void Shader::SetFloat(const GLchar *name, GLfloat value, GLboolean useShader)
 {
 	if (useShader)
 		this->Use();
-	glUniform1f(glGetUniformLocation(this->ID, name), value);
+	glUniform1f(this->GetUniformLocation(name), value);
 }
 void Shader::SetInteger(const GLchar *name, GLint value, GLboolean useShader)
 {
 	if (useShader)
 		this->Use();
-	glUniform1i(glGetUniformLocation(this->ID, name), value);
+	glUniform1i(this->GetUniformLocation(name), value);
 }
 void Shader::SetVector2f(const GLchar *name, GLfloat x, GLfloat y, GLboolean useShader)
 {
 	if (useShader)
 		this->Use();
-	glUniform2f(glGetUniformLocation(this->ID, name), x, y);
+	glUniform2f(this->GetUniformLocation(name), x, y);
 }
 void Shader::SetVector2f(const GLchar *name, const glm::vec2 &value, GLboolean useShader)
 {
 	if (useShader)
 		this->Use();
-	glUniform2f(glGetUniformLocation(this->ID, name), value.x, value.y);
+	glUniform2f(this->GetUniformLocation(name), value.x, value.y);
 }
 void Shader::SetVector3f(const GLchar *name, GLfloat x, GLfloat y, GLfloat z, GLboolean useShader)
 {
 	if (useShader)
 		this->Use();
-	glUniform3f(glGetUniformLocation(this->ID, name), x, y, z);
+	glUniform3f(this->GetUniformLocation(name), x, y, z);
 }
 void Shader::SetVector3f(const GLchar *name, const glm::vec3 &value, GLboolean useShader)
 {
 	if (useShader)
 		this->Use();
-	glUniform3f(glGetUniformLocation(this->ID, name), value.x, value.y, value.z);
+	glUniform3f(this->GetUniformLocation(name), value.x, value.y, value.z);
 }
 void Shader::SetVector4f(const GLchar *name, GLfloat x, GLfloat y, GLfloat z, GLfloat w, GLboolean useShader)
 {
 	if (useShader)
 		this->Use();
-	glUniform4f(glGetUniformLocation(this->ID, name), x, y, z, w);
+	glUniform4f(this->GetUniformLocation(name), x, y, z, w);
 }
 void Shader::SetVector4f(const GLchar *name, const glm::vec4 &value, GLboolean useShader)
 {
 	if (useShader)
 		this->Use();
-	glUniform4f(glGetUniformLocation(this->ID, name), value.x, value.y, value.z, value.w);
+	glUniform4f(this->GetUniformLocation(name), value.x, value.y, value.z, value.w);
 }
 void Shader::SetMatrix4(const GLchar *name, const glm::mat4 &matrix, GLboolean useShader)
 {
 	if (useShader)
 		this->Use();
-	glUniformMatrix4fv(glGetUniformLocation(this->ID, name), 1, GL_FALSE, glm::value_ptr(matrix));
+	glUniformMatrix4fv(this->GetUniformLocation(name), 1, GL_FALSE, glm::value_ptr(matrix));
+}
+
+void Shader::Set(Uniform<GLfloat> uniform, GLfloat value)
+{
+	glUniform1f(uniform.Location, value);
+}
+void Shader::Set(Uniform<GLint> uniform, GLint value)
+{
+	glUniform1i(uniform.Location, value);
+}
+void Shader::Set(Uniform<glm::vec2> uniform, const glm::vec2 &value)
+{
+	glUniform2f(uniform.Location, value.x, value.y);
+}
+void Shader::Set(Uniform<glm::vec3> uniform, const glm::vec3 &value)
+{
+	glUniform3f(uniform.Location, value.x, value.y, value.z);
+}
+void Shader::Set(Uniform<glm::vec4> uniform, const glm::vec4 &value)
+{
+	glUniform4f(uniform.Location, value.x, value.y, value.z, value.w);
+}
+void Shader::Set(Uniform<glm::mat4> uniform, const glm::mat4 &matrix)
+{
+	glUniformMatrix4fv(uniform.Location, 1, GL_FALSE, glm::value_ptr(matrix));
 }
 
 
@@ -9,13 +9,32 @@
 #ifndef SHADER_H
 #define SHADER_H
 
+#include <memory>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 #include <GL/glew.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
 
+// Uniform block binding point of the "Matrices" block (projection matrix)
+// shared by every shader that declares it
+const GLuint MATRICES_BINDING = 0;
+
+
+// Typed handle to a uniform location of a linked shader program. Resolve
+// it once through Shader::GetUniform and set it without any name lookup.
+template <typename T>
+struct Uniform {
+	GLint Location;
+
+	Uniform() : Location(-1) { }
+	explicit Uniform(GLint location) : Location(location) { }
+};
+
+
 // General purpsoe shader object. Compiles from file, generates
 // compile/link-time error messages and hosts several utility 
 // functions for easy management.
@@ -30,6 +49,12 @@ public:
 	Shader  &Use();
 	// Compiles the shader from given source code
 	void    Compile(const GLchar *vertexSource, const GLchar *fragmentSource, const GLchar *geometrySource = nullptr); // Note: geometry source code is optional 
+	// Compiles a vertex-only program whose given outputs are captured (interleaved) with transform feedback
+	void    CompileFeedback(const GLchar *vertexSource, const GLchar **varyings, GLsizei count);
+	// Creates the program from a binary retrieved with GetBinary; returns false if the driver rejects it
+	GLboolean LoadBinary(GLenum format, const void *binary, GLsizei length);
+	// Retrieves the linked program as a driver specific binary (empty if unsupported)
+	void    GetBinary(GLenum &format, std::vector<char> &binary) const;
 																													   // Utility functions
 	void    SetFloat(const GLchar *name, GLfloat value, GLboolean useShader = false);
 	void    SetInteger(const GLchar *name, GLint value, GLboolean useShader = false);
@@ -40,7 +65,22 @@ public:
 	void    SetVector4f(const GLchar *name, GLfloat x, GLfloat y, GLfloat z, GLfloat w, GLboolean useShader = false);
 	void    SetVector4f(const GLchar *name, const glm::vec4 &value, GLboolean useShader = false);
 	void    SetMatrix4(const GLchar *name, const glm::mat4 &matrix, GLboolean useShader = false);
+	// Uniform handles, resolved from the location cache built at link time
+	GLint   GetUniformLocation(const GLchar *name) const;
+	template <typename T>
+	Uniform<T> GetUniform(const GLchar *name) const { return Uniform<T>(this->GetUniformLocation(name)); }
+	// Handle based setters; like the name based ones, they expect the shader to be in use
+	void    Set(Uniform<GLfloat> uniform, GLfloat value);
+	void    Set(Uniform<GLint> uniform, GLint value);
+	void    Set(Uniform<glm::vec2> uniform, const glm::vec2 &value);
+	void    Set(Uniform<glm::vec3> uniform, const glm::vec3 &value);
+	void    Set(Uniform<glm::vec4> uniform, const glm::vec4 &value);
+	void    Set(Uniform<glm::mat4> uniform, const glm::mat4 &matrix);
 private:
+	// Uniform name -> location, shared between copies of the same program
+	std::shared_ptr<std::unordered_map<std::string, GLint>> uniforms;
+	// Queries all active uniforms of the linked program and binds its uniform blocks
+	void    cacheUniforms();
 	// Checks if compilation or linking failed and if so, print the error logs
 	void    checkCompileErrors(GLuint object, std::string type);
 };
@@ -1,17 +1,22 @@
 #version 330 core
 layout (location = 0) in vec4 vertex; // <vec2 position, vec2 texCoords>
+layout (location = 1) in vec2 offset; // per particle
+layout (location = 2) in vec4 color;  // per particle
 
 out vec2 TexCoords;
 out vec4 ParticleColor;
 
-uniform mat4 projection;
-uniform vec2 offset;
-uniform vec4 color;
+layout (std140) uniform Matrices
+{
+    mat4 projection;
+};
+
+uniform vec4 region; // <vec2 uv0, vec2 uv1> of the particle sprite in its (atlas) texture
 
 void main()
 {
     float scale = 10.0f;
-    TexCoords = vertex.zw;
+    TexCoords = mix(region.xy, region.zw, vertex.zw);
     ParticleColor = color;
     gl_Position = projection * vec4((vertex.xy * scale) + offset, 0.0, 1.0);
 }
\ No newline at end of file
@@ -0,0 +1,30 @@
+#version 330 core
+layout (location = 0) in vec2 position;
+layout (location = 1) in vec2 velocity;
+layout (location = 2) in vec4 color;
+layout (location = 3) in float life;
+
+// Captured with transform feedback, in ParticleState order
+out vec2  outPosition;
+out vec2  outVelocity;
+out vec4  outColor;
+out float outLife;
+
+uniform float dt;
+
+void main()
+{
+    outLife = life - dt;
+    outVelocity = velocity;
+    if (outLife > 0.0)
+    {
+        outPosition = position - velocity * dt;
+        outColor = vec4(color.rgb, color.a - dt * 2.5);
+    }
+    else
+    {
+        // Park dead particles off-screen so drawing them costs nothing
+        outPosition = vec2(-10000.0);
+        outColor = vec4(0.0);
+    }
+}
\ No newline at end of file
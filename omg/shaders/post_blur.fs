@@ -0,0 +1,20 @@
+#version 330 core
+in  vec2  TexCoords;
+out vec4  color;
+
+uniform sampler2D scene;
+uniform vec2      texelSize; // Size of a texel of the pass input in texture coordinates
+
+// One direction (HORIZONTAL or VERTICAL) of a separable 5 tap binomial
+// blur (1 4 6 4 1) / 16. Each pair of outer taps is folded into a single
+// bilinear fetch between them, so it takes three texture fetches.
+void main()
+{
+#ifdef HORIZONTAL
+    vec2 offset = vec2(texelSize.x * 1.2, 0.0);
+#else
+    vec2 offset = vec2(0.0, texelSize.y * 1.2);
+#endif
+    color = texture(scene, TexCoords) * 0.375 +
+        (texture(scene, TexCoords - offset) + texture(scene, TexCoords + offset)) * 0.3125;
+}
@@ -3,42 +3,31 @@ in  vec2  TexCoords;
 out vec4  color;
   
 uniform sampler2D scene;
-uniform vec2      offsets[9];
-uniform int       edge_kernel[9];
-uniform float     blur_kernel[9];
+uniform vec2      texelSize; // Size of a texel of the pass input in texture coordinates
 
-uniform bool chaos;
-uniform bool confuse;
-uniform bool shake;
+// Effects are compiled in with CHAOS, CONFUSE and SHAKE defines; the
+// blur of SHAKE is applied beforehand by the separable post_blur.fs passes
+#ifdef CHAOS
+// Edge detection kernel, sampled two pixels apart
+const float edge_kernel[9] = float[](
+    -1.0, -1.0, -1.0,
+    -1.0,  8.0, -1.0,
+    -1.0, -1.0, -1.0
+);
+const float edge_spacing = 2.0;
+#endif
 
 void main()
 {
-    color = vec4(0.0f);
-    vec3 sample[9];
-    // sample from texture offsets if using convolution matrix
-    if(chaos || shake)
-        for(int i = 0; i < 9; i++)
-            sample[i] = vec3(texture(scene, TexCoords.st + offsets[i]));
-
-    // process effects
-    if(chaos)
-    {           
-        for(int i = 0; i < 9; i++)
-            color += vec4(sample[i] * edge_kernel[i], 0.0f);
-        color.a = 1.0f;
-    }
-    else if(confuse)
-    {
-        color = vec4(1.0 - texture(scene, TexCoords).rgb, 1.0);
-    }
-    else if(shake)
-    {
-        for(int i = 0; i < 9; i++)
-            color += vec4(sample[i] * blur_kernel[i], 0.0f);
-        color.a = 1.0f;
-    }
-    else
-    {
-        color =  texture(scene, TexCoords);
-    }
+#if defined(CHAOS)
+    vec3 sum = vec3(0.0);
+    for(int y = -1; y <= 1; y++)
+        for(int x = -1; x <= 1; x++)
+            sum += texture(scene, TexCoords + vec2(x, -y) * texelSize * edge_spacing).rgb * edge_kernel[(y + 1) * 3 + x + 1];
+    color = vec4(sum, 1.0f);
+#elif defined(CONFUSE)
+    color = vec4(1.0 - texture(scene, TexCoords).rgb, 1.0);
+#else
+    color =  texture(scene, TexCoords);
+#endif
 }
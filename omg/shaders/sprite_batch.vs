@@ -0,0 +1,25 @@
+#version 330 core
+layout (location = 0) in vec4 vertex;   // <vec2 position, vec2 texCoords>
+layout (location = 1) in vec4 instance; // <vec2 position, vec2 size>
+layout (location = 2) in vec4 tint;     // <vec3 color, float rotation>
+layout (location = 3) in vec4 region;   // <vec2 uv0, vec2 uv1> of the sprite in its (atlas) texture
+
+out vec2 TexCoords;
+out vec3 SpriteColor;
+
+layout (std140) uniform Matrices
+{
+    mat4 projection;
+};
+
+void main()
+{
+    TexCoords = mix(region.xy, region.zw, vertex.zw);
+    SpriteColor = tint.rgb;
+    // Rotate around the sprite's center, then scale and move it into place
+    vec2 local = (vertex.xy - 0.5) * instance.zw;
+    float s = sin(tint.a);
+    float c = cos(tint.a);
+    vec2 rotated = vec2(c * local.x - s * local.y, s * local.x + c * local.y);
+    gl_Position = projection * vec4(instance.xy + 0.5 * instance.zw + rotated, 0.0, 1.0);
+}
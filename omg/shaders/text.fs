@@ -4,9 +4,16 @@ out vec4 color;
 
 uniform sampler2D text;
 uniform vec3 textColor;
+uniform vec3 outlineColor;
+uniform float outlineWidth; // In distance units, 0 for no outline
 
 void main()
 {    
-    vec4 sampled = vec4(1.0, 1.0, 1.0, texture(text, TexCoords).r);
-    color = vec4(textColor, 1.0) * sampled;
-}  
\ No newline at end of file
+    // The atlas holds signed distance fields: 0.5 is the glyph's outline.
+    // Smooth over about a pixel on screen so edges stay sharp at any scale.
+    float distance = texture(text, TexCoords).r;
+    float smoothing = fwidth(distance) * 0.75;
+    float fill = smoothstep(0.5 - smoothing, 0.5 + smoothing, distance);
+    float shape = smoothstep(0.5 - outlineWidth - smoothing, 0.5 - outlineWidth + smoothing, distance);
+    color = vec4(mix(outlineColor, textColor, fill), shape);
+}  
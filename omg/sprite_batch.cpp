@@ -0,0 +1,146 @@
+/*******************************************************************
+** This code is part of Breakout.
+**
+** Breakout is free software: you can redistribute it and/or modify
+** it under the terms of the CC BY 4.0 license as published by
+** Creative Commons, either version 4 of the License, or (at your
+** option) any later version.
+******************************************************************/
+#include "sprite_batch.h"
+
+#include <algorithm>
+#include <cstddef>
+
+SpriteBatch::SpriteBatch(Shader &shader)
+	: DrawCalls(0), Sprites(0), sortByTexture(GL_FALSE), instanceCapacity(0)
+{
+	this->shader = shader;
+	this->initRenderData();
+}
+
+SpriteBatch::~SpriteBatch()
+{
+	glDeleteVertexArrays(1, &this->quadVAO);
+	glDeleteBuffers(1, &this->quadVBO);
+	glDeleteBuffers(1, &this->instanceVBO);
+}
+
+void SpriteBatch::initRenderData()
+{
+	// Configure VAO/VBO, the quad is shared by every instance
+	GLfloat vertices[] = {
+		// Pos      // Tex
+		0.0f, 1.0f, 0.0f, 1.0f,
+		1.0f, 0.0f, 1.0f, 0.0f,
+		0.0f, 0.0f, 0.0f, 0.0f,
+
+		0.0f, 1.0f, 0.0f, 1.0f,
+		1.0f, 1.0f, 1.0f, 1.0f,
+		1.0f, 0.0f, 1.0f, 0.0f
+	};
+
+	glGenVertexArrays(1, &this->quadVAO);
+	glGenBuffers(1, &this->quadVBO);
+	glGenBuffers(1, &this->instanceVBO);
+
+	glBindVertexArray(this->quadVAO);
+	glBindBuffer(GL_ARRAY_BUFFER, this->quadVBO);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(GLfloat), (GLvoid*)0);
+	// Instance attributes advance once per sprite; their pointers are set per texture run in End()
+	glBindBuffer(GL_ARRAY_BUFFER, this->instanceVBO);
+	glEnableVertexAttribArray(1);
+	glVertexAttribDivisor(1, 1);
+	glEnableVertexAttribArray(2);
+	glVertexAttribDivisor(2, 1);
+	glEnableVertexAttribArray(3);
+	glVertexAttribDivisor(3, 1);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindVertexArray(0);
+}
+
+void SpriteBatch::Begin(GLboolean sortByTexture)
+{
+	this->sortByTexture = sortByTexture;
+	this->Textures.clear();
+	this->Instances.clear();
+}
+
+void SpriteBatch::DrawSprite(const Texture2D &texture, glm::vec2 position,
+	glm::vec2 size, GLfloat rotate, glm::vec3 color)
+{
+	SpriteInstance instance;
+	instance.Position = position;
+	instance.Size = size;
+	instance.Color = color;
+	instance.Rotation = rotate;
+	instance.Region = texture.Region;
+	this->Textures.push_back(texture.ID);
+	this->Instances.push_back(instance);
+}
+
+void SpriteBatch::End()
+{
+	GLuint count = this->Instances.size();
+	if (count == 0)
+		return;
+	// Group sprites by texture if requested; a stable sort keeps the submission order within each texture
+	const SpriteInstance *data = this->Instances.data();
+	if (this->sortByTexture)
+	{
+		this->order.resize(count);
+		for (GLuint i = 0; i < count; ++i)
+			this->order[i] = i;
+		const std::vector<GLuint> &textures = this->Textures;
+		std::stable_sort(this->order.begin(), this->order.end(),
+			[&textures](GLuint a, GLuint b) { return textures[a] < textures[b]; });
+		this->staging.resize(count);
+		this->sortedTextures.resize(count);
+		for (GLuint i = 0; i < count; ++i)
+		{
+			this->staging[i] = this->Instances[this->order[i]];
+			this->sortedTextures[i] = this->Textures[this->order[i]];
+		}
+		this->Textures.swap(this->sortedTextures);
+		data = this->staging.data();
+	}
+	// Upload all instances at once, orphaning the old storage so we don't stall on the previous frame
+	glBindBuffer(GL_ARRAY_BUFFER, this->instanceVBO);
+	if (count > this->instanceCapacity)
+		this->instanceCapacity = std::max(count, this->instanceCapacity * 2);
+	glBufferData(GL_ARRAY_BUFFER, this->instanceCapacity * sizeof(SpriteInstance), NULL, GL_STREAM_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, count * sizeof(SpriteInstance), data);
+
+	this->shader.Use();
+	glActiveTexture(GL_TEXTURE0);
+	glBindVertexArray(this->quadVAO);
+	// Issue one instanced draw per run of sprites sharing a texture
+	GLuint first = 0;
+	while (first < count)
+	{
+		GLuint last = first + 1;
+		while (last < count && this->Textures[last] == this->Textures[first])
+			++last;
+		GLsizeiptr offset = first * sizeof(SpriteInstance);
+		glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(SpriteInstance), (GLvoid*)offset);
+		glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(SpriteInstance), (GLvoid*)(offset + offsetof(SpriteInstance, Color)));
+		glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(SpriteInstance), (GLvoid*)(offset + offsetof(SpriteInstance, Region)));
+		glBindTexture(GL_TEXTURE_2D, this->Textures[first]);
+		glDrawArraysInstanced(GL_TRIANGLES, 0, 6, last - first);
+		++this->DrawCalls;
+		first = last;
+	}
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	this->Sprites += count;
+
+	this->Textures.clear();
+	this->Instances.clear();
+}
+
+void SpriteBatch::ResetStats()
+{
+	this->DrawCalls = 0;
+	this->Sprites = 0;
+}
\ No newline at end of file
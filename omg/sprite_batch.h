@@ -0,0 +1,69 @@
+/*******************************************************************
+** This code is part of Breakout.
+**
+** Breakout is free software: you can redistribute it and/or modify
+** it under the terms of the CC BY 4.0 license as published by
+** Creative Commons, either version 4 of the License, or (at your
+** option) any later version.
+******************************************************************/
+#ifndef SPRITE_BATCH_H
+#define SPRITE_BATCH_H
+#include <vector>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "texture.h"
+#include "shader.h"
+
+
+// Per-instance vertex data of a single batched sprite, laid out
+// exactly as the instanced attributes of sprite_batch.vs expect it
+struct SpriteInstance {
+	glm::vec2 Position, Size;
+	glm::vec3 Color;
+	GLfloat   Rotation;
+	glm::vec4 Region;
+};
+
+
+// SpriteBatch collects sprites between Begin() and End() and submits
+// every run of sprites that share a texture with a single instanced
+// draw call, instead of one draw call per sprite like SpriteRenderer.
+// Sprites are drawn in submission order unless the batch was begun
+// with sortByTexture, in which case sprites are (stably) grouped by
+// texture so each texture is bound only once per batch.
+class SpriteBatch
+{
+public:
+	// Statistics of the last frame (reset by ResetStats())
+	GLuint DrawCalls, Sprites;
+	// Constructor (inits shaders/shapes)
+	SpriteBatch(Shader &shader);
+	// Destructor
+	~SpriteBatch();
+	// Starts collecting sprites
+	void Begin(GLboolean sortByTexture = GL_FALSE);
+	// Queues a quad textured with given sprite; nothing is drawn until End()
+	void DrawSprite(const Texture2D &texture, glm::vec2 position, glm::vec2 size = glm::vec2(10, 10), GLfloat rotate = 0.0f, glm::vec3 color = glm::vec3(1.0f));
+	// Uploads all queued sprites and draws them, one draw call per texture run
+	void End();
+	// Clears the draw call/sprite counters, should be called once per frame
+	void ResetStats();
+private:
+	// Queued sprites; Textures[i] is the texture of Instances[i]
+	std::vector<GLuint>         Textures;
+	std::vector<SpriteInstance> Instances;
+	// Scratch storage for sorting, kept around so End() doesn't allocate every frame
+	std::vector<GLuint>         order, sortedTextures;
+	std::vector<SpriteInstance> staging;
+	GLboolean sortByTexture;
+	// Render state
+	Shader shader;
+	GLuint quadVAO, quadVBO, instanceVBO;
+	GLuint instanceCapacity;
+	// Initializes and configures the quad's buffer and vertex attributes
+	void initRenderData();
+};
+
+#endif
\ No newline at end of file
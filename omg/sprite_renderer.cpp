@@ -11,6 +11,9 @@
 SpriteRenderer::SpriteRenderer(Shader &shader)
 {
 	this->shader = shader;
+	this->modelUniform = shader.GetUniform<glm::mat4>("model");
+	this->colorUniform = shader.GetUniform<glm::vec3>("spriteColor");
+	this->regionUniform = shader.GetUniform<glm::vec4>("region");
 	this->initRenderData();
 }
 
@@ -61,8 +64,9 @@ void SpriteRenderer::DrawSprite(Texture2D &texture, glm::vec2 position,
 
 	model = glm::scale(model, glm::vec3(size, 1.0f));
 
-	this->shader.SetMatrix4("model", model);
-	this->shader.SetVector3f("spriteColor", color);
+	this->shader.Set(this->modelUniform, model);
+	this->shader.Set(this->colorUniform, color);
+	this->shader.Set(this->regionUniform, texture.Region);
 
 	glActiveTexture(GL_TEXTURE0);
 	texture.Bind();
@@ -29,6 +29,9 @@ public:
 private:
 	// Render state
 	Shader shader;
+	Uniform<glm::mat4> modelUniform;
+	Uniform<glm::vec3> colorUniform;
+	Uniform<glm::vec4> regionUniform;
 	GLuint quadVAO;
 	// Initializes and configures the quad's buffer and vertex attributes
 	void initRenderData();
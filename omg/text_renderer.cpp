@@ -6,7 +6,13 @@
 ** Creative Commons, either version 4 of the License, or (at your
 ** option) any later version.
 ******************************************************************/
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
 #include <iostream>
+#include <sys/stat.h>
 
 #include <glm/gtc/matrix_transform.hpp>
 #include <ft2build.h>
@@ -14,43 +20,172 @@
 
 #include "text_renderer.h"
 #include "resource_manager.h"
+#include "texture_atlas.h"
 
+// Name of the text shader, hashed by the compiler
+static constexpr ResourceName TEXT_SHADER("text");
 
-TextRenderer::TextRenderer(GLuint width, GLuint height)
+
+TextRenderer::TextRenderer()
+	: Characters(), vertexCapacity(0), baseline(0), unit(1.0f)
 {
 	// Load and configure shader
-	this->TextShader = ResourceManager::LoadShader("shaders/text.vs", "shaders/text.fs", nullptr, "text");
-	this->TextShader.SetMatrix4("projection", glm::ortho(0.0f, static_cast<GLfloat>(width), static_cast<GLfloat>(height), 0.0f), GL_TRUE);
-	this->TextShader.SetInteger("text", 0);
+	this->TextShader = ResourceManager::GetShader(ResourceManager::LoadShader("shaders/text.vs", "shaders/text.fs", nullptr, TEXT_SHADER));
+	// The projection comes from the shared Matrices block (see ResourceManager::SetProjection)
+	this->TextShader.SetInteger("text", 0, GL_TRUE);
+	this->textColor = this->TextShader.GetUniform<glm::vec3>("textColor");
+	this->outlineColor = this->TextShader.GetUniform<glm::vec3>("outlineColor");
+	this->outlineWidth = this->TextShader.GetUniform<GLfloat>("outlineWidth");
 	// Configure VAO/VBO for texture quads
 	glGenVertexArrays(1, &this->VAO);
 	glGenBuffers(1, &this->VBO);
 	glBindVertexArray(this->VAO);
 	glBindBuffer(GL_ARRAY_BUFFER, this->VBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * 6 * 4, NULL, GL_DYNAMIC_DRAW);
 	glEnableVertexAttribArray(0);
 	glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(GLfloat), 0);
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
 	glBindVertexArray(0);
 }
 
+// Bump whenever the layout of cached atlases (or how they are generated) changes
+const GLuint SDF_CACHE_VERSION = 1;
+
+// Header of a cached distance field atlas, followed by the 128 Characters
+// and Size x Size texels of the atlas
+struct SDFCacheHeader {
+	char     Magic[4];   // "SDFF"
+	GLuint   Version;
+	GLuint   GlyphSize, Spread;
+	GLuint   Size;       // Width and height of the atlas
+	GLint    Baseline;
+	uint64_t SourceSize; // Size and modification time of the font it was generated from
+	uint64_t SourceTime;
+};
+
 void TextRenderer::Load(std::string font, GLuint fontSize)
 {
 	// First clear the previously loaded Characters
-	this->Characters.clear();
-	// Then initialize and load the FreeType library
+	std::fill(this->Characters, this->Characters + 128, Character());
+	// The atlas doesn't depend on fontSize, only how large it is drawn does
+	this->unit = static_cast<GLfloat>(fontSize) / SDF_GLYPH_SIZE;
+	struct stat source;
+	GLboolean haveSource = stat(font.c_str(), &source) == 0;
+	uint64_t sourceSize = haveSource ? static_cast<uint64_t>(source.st_size) : 0;
+	uint64_t sourceTime = haveSource ? static_cast<uint64_t>(source.st_mtime) : 0;
+	std::string cacheFile = font + ".sdf";
+	GLuint size = 0;
+	std::vector<unsigned char> pixels;
+	if (!this->loadCache(cacheFile, sourceSize, sourceTime, size, pixels))
+	{
+		if (!this->generate(font, size, pixels))
+			return;
+		this->saveCache(cacheFile, sourceSize, sourceTime, size, pixels);
+	}
+	this->Atlas.Internal_Format = GL_RED;
+	this->Atlas.Image_Format = GL_RED;
+	this->Atlas.Wrap_S = GL_CLAMP_TO_EDGE;
+	this->Atlas.Wrap_T = GL_CLAMP_TO_EDGE;
+	this->Atlas.Generate(size, size, pixels.data());
+}
+
+GLboolean TextRenderer::loadCache(const std::string &cacheFile, uint64_t sourceSize, uint64_t sourceTime, GLuint &size, std::vector<unsigned char> &pixels)
+{
+	std::ifstream file(cacheFile, std::ios::binary);
+	SDFCacheHeader header;
+	if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)))
+		return GL_FALSE;
+	// A stale or foreign cache is simply generated again
+	if (memcmp(header.Magic, "SDFF", 4) != 0 || header.Version != SDF_CACHE_VERSION ||
+		header.GlyphSize != SDF_GLYPH_SIZE || header.Spread != SDF_SPREAD ||
+		header.SourceSize != sourceSize || header.SourceTime != sourceTime)
+		return GL_FALSE;
+	pixels.resize(static_cast<size_t>(header.Size) * header.Size);
+	if (!file.read(reinterpret_cast<char*>(this->Characters), sizeof(this->Characters)) ||
+		!file.read(reinterpret_cast<char*>(pixels.data()), pixels.size()))
+	{
+		std::fill(this->Characters, this->Characters + 128, Character());
+		return GL_FALSE;
+	}
+	size = header.Size;
+	this->baseline = header.Baseline;
+	return GL_TRUE;
+}
+
+void TextRenderer::saveCache(const std::string &cacheFile, uint64_t sourceSize, uint64_t sourceTime, GLuint size, const std::vector<unsigned char> &pixels) const
+{
+	SDFCacheHeader header;
+	memcpy(header.Magic, "SDFF", 4);
+	header.Version = SDF_CACHE_VERSION;
+	header.GlyphSize = SDF_GLYPH_SIZE;
+	header.Spread = SDF_SPREAD;
+	header.Size = size;
+	header.Baseline = this->baseline;
+	header.SourceSize = sourceSize;
+	header.SourceTime = sourceTime;
+	// Not being able to write the cache (e.g. read-only install) only costs startup time
+	std::ofstream file(cacheFile, std::ios::binary);
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.write(reinterpret_cast<const char*>(this->Characters), sizeof(this->Characters));
+	file.write(reinterpret_cast<const char*>(pixels.data()), pixels.size());
+	if (!file)
+	{
+		file.close();
+		remove(cacheFile.c_str());
+	}
+}
+
+// Turns a glyph's coverage bitmap into a signed distance field with SDF_SPREAD texels
+// of border around it. 0.5 (128) is the outline, larger values are inside.
+static void distanceField(const FT_Bitmap &bitmap, std::vector<unsigned char> &field)
+{
+	const GLint spread = SDF_SPREAD;
+	GLint width = bitmap.width, height = bitmap.rows;
+	GLint fieldWidth = width + 2 * spread, fieldHeight = height + 2 * spread;
+	auto inside = [&](GLint x, GLint y) {
+		return x >= 0 && y >= 0 && x < width && y < height && bitmap.buffer[y * bitmap.pitch + x] >= 128;
+	};
+	field.resize(fieldWidth * fieldHeight);
+	for (GLint y = 0; y < fieldHeight; ++y)
+		for (GLint x = 0; x < fieldWidth; ++x)
+		{
+			// Search the spread around the texel for the nearest one on the other side of the outline
+			GLint gx = x - spread, gy = y - spread;
+			GLboolean in = inside(gx, gy);
+			GLint nearest = (spread + 1) * (spread + 1);
+			for (GLint dy = -spread; dy <= spread; ++dy)
+				for (GLint dx = -spread; dx <= spread; ++dx)
+					if (dx * dx + dy * dy < nearest && inside(gx + dx, gy + dy) != in)
+						nearest = dx * dx + dy * dy;
+			// The outline lies halfway between the two texels
+			GLfloat distance = std::min(std::sqrt(static_cast<GLfloat>(nearest)), static_cast<GLfloat>(spread + 1)) - 0.5f;
+			GLfloat value = 0.5f + (in ? distance : -distance) / (2.0f * spread);
+			field[y * fieldWidth + x] = static_cast<unsigned char>(std::min(std::max(value, 0.0f), 1.0f) * 255.0f + 0.5f);
+		}
+}
+
+GLboolean TextRenderer::generate(const std::string &font, GLuint &size, std::vector<unsigned char> &pixels)
+{
+	// Initialize and load the FreeType library
 	FT_Library ft;
 	if (FT_Init_FreeType(&ft)) // All functions return a value different than 0 whenever an error occurred
+	{
 		std::cout << "ERROR::FREETYPE: Could not init FreeType Library" << std::endl;
+		return GL_FALSE;
+	}
 	// Load font as face
 	FT_Face face;
 	if (FT_New_Face(ft, font.c_str(), 0, &face))
+	{
 		std::cout << "ERROR::FREETYPE: Failed to load font" << std::endl;
+		FT_Done_FreeType(ft);
+		return GL_FALSE;
+	}
 	// Set size to load glyphs as
-	FT_Set_Pixel_Sizes(face, 0, fontSize);
-	// Disable byte-alignment restriction
-	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-	// Then for the first 128 ASCII characters, pre-load/compile their characters and store them
+	FT_Set_Pixel_Sizes(face, 0, SDF_GLYPH_SIZE);
+	// Render the first 128 ASCII characters; FreeType reuses its bitmap, so keep the field of each
+	std::vector<std::vector<unsigned char>> fields(128);
+	std::vector<AtlasImage> glyphs;
+	std::vector<GLubyte> codes; // Character of each glyph
 	for (GLubyte c = 0; c < 128; c++) // lol see what I did there 
 	{
 		// Load character glyph 
@@ -59,83 +194,194 @@ void TextRenderer::Load(std::string font, GLuint fontSize)
 			std::cout << "ERROR::FREETYTPE: Failed to load Glyph" << std::endl;
 			continue;
 		}
-		// Generate texture
-		GLuint texture;
-		glGenTextures(1, &texture);
-		glBindTexture(GL_TEXTURE_2D, texture);
-		glTexImage2D(
-			GL_TEXTURE_2D,
-			0,
-			GL_RED,
-			face->glyph->bitmap.width,
-			face->glyph->bitmap.rows,
-			0,
-			GL_RED,
-			GL_UNSIGNED_BYTE,
-			face->glyph->bitmap.buffer
-		);
-		// Set texture options
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-		// Now store character for later use
+		FT_Bitmap &bitmap = face->glyph->bitmap;
+		GLboolean empty = bitmap.width == 0 || bitmap.rows == 0; // Nothing to draw (e.g. space)
 		Character character = {
-			texture,
-			glm::ivec2(face->glyph->bitmap.width, face->glyph->bitmap.rows),
-			glm::ivec2(face->glyph->bitmap_left, face->glyph->bitmap_top),
-			face->glyph->advance.x
+			glm::vec4(0.0f),
+			empty ? glm::ivec2(0) : glm::ivec2(bitmap.width + 2 * SDF_SPREAD, bitmap.rows + 2 * SDF_SPREAD),
+			glm::ivec2(face->glyph->bitmap_left - SDF_SPREAD, face->glyph->bitmap_top + SDF_SPREAD),
+			static_cast<GLuint>(face->glyph->advance.x)
 		};
-		Characters.insert(std::pair<GLchar, Character>(c, character));
+		this->Characters[c] = character;
+		if (c == 'H')
+			this->baseline = face->glyph->bitmap_top;
+		if (empty)
+			continue;
+		distanceField(bitmap, fields[c]);
+		AtlasImage glyph;
+		glyph.Width = character.Size.x;
+		glyph.Height = character.Size.y;
+		glyph.Pixels = fields[c].data();
+		glyphs.push_back(glyph);
+		codes.push_back(c);
 	}
-	glBindTexture(GL_TEXTURE_2D, 0);
 	// Destroy FreeType once we're finished
 	FT_Done_Face(face);
 	FT_Done_FreeType(ft);
+	// Pack all glyphs into a single page, growing it until they fit
+	GLint maxSize;
+	glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+	size = 128;
+	while (AtlasPacker(size).Pack(glyphs) > 1 && size < static_cast<GLuint>(maxSize))
+		size *= 2;
+	// Copy them in (the padding stays empty, i.e. far outside) and remember where each one went
+	pixels.assign(size * size, 0);
+	for (GLuint i = 0; i < glyphs.size(); ++i)
+	{
+		const AtlasImage &glyph = glyphs[i];
+		if (glyph.Page != 0)
+			continue;
+		for (GLuint row = 0; row < glyph.Height; ++row)
+			memcpy(&pixels[(glyph.Y + row) * size + glyph.X], glyph.Pixels + row * glyph.Width, glyph.Width);
+		this->Characters[codes[i]].Region = glm::vec4(glyph.X, glyph.Y, glyph.X + glyph.Width, glyph.Y + glyph.Height) / static_cast<GLfloat>(size);
+	}
+	return GL_TRUE;
 }
 
-void TextRenderer::RenderText(std::string text, GLfloat x, GLfloat y, GLfloat scale, glm::vec3 color)
+void TextRenderer::RenderText(std::string text, GLfloat x, GLfloat y, GLfloat scale, glm::vec3 color,
+	GLfloat outline, glm::vec3 outlineColor)
 {
-	// Activate corresponding render state	
-	this->TextShader.Use();
-	this->TextShader.SetVector3f("textColor", color);
-	glActiveTexture(GL_TEXTURE0);
-	glBindVertexArray(this->VAO);
+	this->vertices.clear();
+	this->layoutText(text.c_str(), text.size(), x, y, scale);
+	GLuint count = this->vertices.size() / 4;
+	if (count == 0)
+		return;
+	this->uploadVertices(this->VBO, this->vertexCapacity);
+	this->draw(this->VAO, count, color, outline, outlineColor);
+}
 
-	// Iterate through all characters
-	std::string::const_iterator c;
-	for (c = text.begin(); c != text.end(); c++)
+void TextRenderer::RenderText(TextLayout &layout)
+{
+	if (layout.dirty || layout.X != layout.laidX || layout.Y != layout.laidY || layout.Scale != layout.laidScale)
 	{
-		Character ch = Characters[*c];
-
-		GLfloat xpos = x + ch.Bearing.x * scale;
-		GLfloat ypos = y + (this->Characters['H'].Bearing.y - ch.Bearing.y) * scale;
-
-		GLfloat w = ch.Size.x * scale;
-		GLfloat h = ch.Size.y * scale;
-		// Update VBO for each character
-		GLfloat vertices[6][4] = {
-			{ xpos,     ypos + h,   0.0, 1.0 },
-			{ xpos + w, ypos,       1.0, 0.0 },
-			{ xpos,     ypos,       0.0, 0.0 },
-
-			{ xpos,     ypos + h,   0.0, 1.0 },
-			{ xpos + w, ypos + h,   1.0, 1.0 },
-			{ xpos + w, ypos,       1.0, 0.0 }
-		};
-		// Render glyph texture over quad
-		glBindTexture(GL_TEXTURE_2D, ch.TextureID);
-		// Update content of VBO memory
-		glBindBuffer(GL_ARRAY_BUFFER, this->VBO);
-		glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(vertices), vertices); // Be sure to use glBufferSubData and not glBufferData
-
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
-		// Render quad
-		glDrawArrays(GL_TRIANGLES, 0, 6);
+		this->vertices.clear();
+		this->layoutText(layout.text, strlen(layout.text), layout.X, layout.Y, layout.Scale);
+		layout.vertexCount = this->vertices.size() / 4;
+		if (layout.vertexCount > 0)
+			this->uploadVertices(layout.VBO, layout.vertexCapacity);
+		layout.dirty = GL_FALSE;
+		layout.laidX = layout.X;
+		layout.laidY = layout.Y;
+		layout.laidScale = layout.Scale;
+	}
+	if (layout.vertexCount > 0)
+		this->draw(layout.VAO, layout.vertexCount, layout.Color, layout.Outline, layout.OutlineColor);
+}
+
+void TextRenderer::layoutText(const GLchar *text, GLuint length, GLfloat x, GLfloat y, GLfloat scale)
+{
+	// Metrics are in distance field texels; convert them to screen pixels
+	scale *= this->unit;
+	for (GLuint i = 0; i < length; ++i)
+	{
+		GLubyte code = static_cast<GLubyte>(text[i]);
+		if (code >= 128)
+			continue;
+		const Character &ch = this->Characters[code];
+		if (ch.Size.x > 0 && ch.Size.y > 0)
+		{
+			GLfloat xpos = x + ch.Bearing.x * scale;
+			GLfloat ypos = y + (this->baseline - ch.Bearing.y) * scale;
+
+			GLfloat w = ch.Size.x * scale;
+			GLfloat h = ch.Size.y * scale;
+			const glm::vec4 &uv = ch.Region;
+			GLfloat quad[6][4] = {
+				{ xpos,     ypos + h,   uv.x, uv.w },
+				{ xpos + w, ypos,       uv.z, uv.y },
+				{ xpos,     ypos,       uv.x, uv.y },
+
+				{ xpos,     ypos + h,   uv.x, uv.w },
+				{ xpos + w, ypos + h,   uv.z, uv.w },
+				{ xpos + w, ypos,       uv.z, uv.y }
+			};
+			this->vertices.insert(this->vertices.end(), &quad[0][0], &quad[0][0] + 24);
+		}
 		// Now advance cursors for next glyph
-		x += (ch.Advance >> 6) * scale; // Bitshift by 6 to get value in pixels (1/64th times 2^6 = 64)
+		x += (ch.Advance / 64.0f) * scale; // Advance is in 1/64th pixels
 	}
+}
+
+void TextRenderer::uploadVertices(GLuint buffer, GLuint &capacity)
+{
+	// Orphan the old storage so we don't wait for the previous contents to be drawn
+	GLuint count = this->vertices.size() / 4;
+	glBindBuffer(GL_ARRAY_BUFFER, buffer);
+	if (count > capacity)
+		capacity = std::max(count, capacity * 2);
+	glBufferData(GL_ARRAY_BUFFER, capacity * 4 * sizeof(GLfloat), NULL, GL_STREAM_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, this->vertices.size() * sizeof(GLfloat), this->vertices.data());
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void TextRenderer::draw(GLuint vao, GLuint count, const glm::vec3 &color, GLfloat outline, const glm::vec3 &outlineColor)
+{
+	// Render the whole string with the glyph atlas in one go
+	this->TextShader.Use();
+	this->TextShader.Set(this->textColor, color);
+	// The outline is given in pixels at scale 1; the shader wants it in distance units (0.5 spans SDF_SPREAD texels)
+	GLfloat width = std::min(outline / this->unit, static_cast<GLfloat>(SDF_SPREAD)) / (2.0f * SDF_SPREAD);
+	this->TextShader.Set(this->outlineWidth, width);
+	this->TextShader.Set(this->outlineColor, outlineColor);
+	glActiveTexture(GL_TEXTURE0);
+	this->Atlas.Bind();
+	glBindVertexArray(vao);
+	glDrawArrays(GL_TRIANGLES, 0, count);
 	glBindVertexArray(0);
 	glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+
+TextLayout::TextLayout(GLfloat x, GLfloat y, GLfloat scale, glm::vec3 color)
+	: X(x), Y(y), Scale(scale), Color(color), Outline(0.0f), OutlineColor(0.0f), dirty(GL_TRUE), laidX(x), laidY(y), laidScale(scale), vertexCount(0), vertexCapacity(0)
+{
+	this->text[0] = '\0';
+	glGenVertexArrays(1, &this->VAO);
+	glGenBuffers(1, &this->VBO);
+	glBindVertexArray(this->VAO);
+	glBindBuffer(GL_ARRAY_BUFFER, this->VBO);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(GLfloat), 0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindVertexArray(0);
+}
+
+TextLayout::~TextLayout()
+{
+	glDeleteVertexArrays(1, &this->VAO);
+	glDeleteBuffers(1, &this->VBO);
+}
+
+void TextLayout::SetText(const char *text)
+{
+	if (strncmp(this->text, text, MAX_LENGTH) == 0)
+		return;
+	strncpy(this->text, text, MAX_LENGTH);
+	this->text[MAX_LENGTH] = '\0';
+	this->dirty = GL_TRUE;
+}
+
+void TextLayout::SetText(const char *prefix, GLint value, const char *suffix)
+{
+	// Format into a stack buffer: prefix, digits (written back to front) and suffix
+	GLchar formatted[MAX_LENGTH + 1];
+	GLuint length = 0;
+	for (; *prefix && length < MAX_LENGTH; ++prefix)
+		formatted[length++] = *prefix;
+	GLchar digits[12];
+	GLuint count = 0;
+	GLuint magnitude = value < 0 ? 0u - static_cast<GLuint>(value) : static_cast<GLuint>(value);
+	do
+	{
+		digits[count++] = '0' + magnitude % 10;
+		magnitude /= 10;
+	} while (magnitude > 0);
+	if (value < 0)
+		digits[count++] = '-';
+	while (count > 0 && length < MAX_LENGTH)
+		formatted[length++] = digits[--count];
+	for (; *suffix && length < MAX_LENGTH; ++suffix)
+		formatted[length++] = *suffix;
+	formatted[length] = '\0';
+	this->SetText(formatted);
 }
\ No newline at end of file
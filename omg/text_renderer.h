@@ -9,7 +9,9 @@
 #ifndef TEXT_RENDERER_H
 #define TEXT_RENDERER_H
 
-#include <map>
+#include <cstdint>
+#include <string>
+#include <vector>
 
 #include <GL/glew.h>
 #include <glm/glm.hpp>
@@ -18,34 +20,109 @@
 #include "shader.h"
 
 
-/// Holds all state information relevant to a character as loaded using FreeType
+/// Holds all state information relevant to a character as loaded using FreeType.
+/// Sizes are in texels of the distance field, which is rendered at SDF_GLYPH_SIZE
+/// and includes SDF_SPREAD texels of border on every side.
 struct Character {
-	GLuint TextureID;   // ID handle of the glyph texture
+	glm::vec4 Region;   // Texture coordinates (u0, v0, u1, v1) of the glyph in the atlas
 	glm::ivec2 Size;    // Size of glyph
 	glm::ivec2 Bearing; // Offset from baseline to left/top of glyph
 	GLuint Advance;     // Horizontal offset to advance to next glyph
 };
 
+// Pixel size glyphs are rendered at for the distance field, and how far
+// (in texels) the field reaches beyond their outline. Outlines can be at
+// most SDF_SPREAD texels wide.
+const GLuint SDF_GLYPH_SIZE = 48;
+const GLuint SDF_SPREAD = 6;
+
+
+// A string whose glyph quads are laid out once and kept in their own
+// vertex buffer. TextRenderer only rebuilds them when the text, position
+// or scale changed since the last draw, so static or rarely changing
+// strings (like the HUD) cost one draw call and no uploads per frame.
+class TextLayout
+{
+public:
+	// Where and how large the text is drawn; changing these re-lays it out
+	GLfloat   X, Y, Scale;
+	// Text color, applied when drawing (doesn't re-lay out)
+	glm::vec3 Color;
+	// Outline width (in pixels at scale 1, 0 for none) and color, applied when drawing
+	GLfloat   Outline;
+	glm::vec3 OutlineColor;
+	// Constructor/Destructor
+	TextLayout(GLfloat x, GLfloat y, GLfloat scale, glm::vec3 color = glm::vec3(1.0f));
+	~TextLayout();
+	// Sets the text; nothing is rebuilt if it didn't change
+	void SetText(const char *text);
+	// Sets the text to prefix, value and suffix; the number is formatted without iostreams or allocations
+	void SetText(const char *prefix, GLint value, const char *suffix = "");
+private:
+	friend class TextRenderer;
+	// Longest text a layout holds, longer ones are cut off
+	static const GLuint MAX_LENGTH = 63;
+	GLchar    text[MAX_LENGTH + 1];
+	// Whether text changed, and the position/scale the current quads were built for
+	GLboolean dirty;
+	GLfloat   laidX, laidY, laidScale;
+	// Render state
+	GLuint    VAO, VBO;
+	GLuint    vertexCount, vertexCapacity;
+	// Not copyable, it owns GL objects
+	TextLayout(const TextLayout&);
+	TextLayout &operator=(const TextLayout&);
+};
+
 
 // A renderer class for rendering text displayed by a font loaded using the 
 // FreeType library. A single font is loaded, processed into a list of Character
-// items for later rendering.
+// items for later rendering. All glyphs share one atlas texture, so a whole
+// string is drawn with a single draw call. The atlas holds signed distance
+// fields rather than coverage, so text stays sharp at any scale and can be
+// outlined; it is generated once and cached next to the font (font + ".sdf").
 class TextRenderer
 {
 public:
-	// Holds a list of pre-compiled Characters
-	std::map<GLchar, Character> Characters;
+	// Holds the pre-compiled Characters, indexed by their ASCII code
+	Character Characters[128];
+	// Single channel distance field texture all glyphs are packed into
+	Texture2D Atlas;
 	// Shader used for text rendering
 	Shader TextShader;
 	// Constructor
-	TextRenderer(GLuint width, GLuint height);
-	// Pre-compiles a list of characters from the given font
+	TextRenderer();
+	// Pre-compiles a list of characters from the given font; fontSize is the pixel size at scale 1
 	void Load(std::string font, GLuint fontSize);
 	// Renders a string of text using the precompiled list of characters
-	void RenderText(std::string text, GLfloat x, GLfloat y, GLfloat scale, glm::vec3 color = glm::vec3(1.0f));
+	void RenderText(std::string text, GLfloat x, GLfloat y, GLfloat scale, glm::vec3 color = glm::vec3(1.0f),
+		GLfloat outline = 0.0f, glm::vec3 outlineColor = glm::vec3(0.0f));
+	// Renders a cached layout, laying it out again first if it changed
+	void RenderText(TextLayout &layout);
 private:
 	// Render state
 	GLuint VAO, VBO;
+	GLuint vertexCapacity;
+	Uniform<glm::vec3> textColor, outlineColor;
+	Uniform<GLfloat>   outlineWidth;
+	// Bearing of 'H', the line every glyph is aligned to
+	GLint baseline;
+	// Screen pixels per distance field texel at scale 1
+	GLfloat unit;
+	// Vertices of the string being rendered, kept around so RenderText doesn't allocate every call
+	std::vector<GLfloat> vertices;
+	// Appends the quads of text, starting at (x, y), to vertices
+	void layoutText(const GLchar *text, GLuint length, GLfloat x, GLfloat y, GLfloat scale);
+	// Uploads vertices into buffer, growing it (to capacity vertices) if needed
+	void uploadVertices(GLuint buffer, GLuint &capacity);
+	// Draws count vertices of vao with the glyph atlas
+	void draw(GLuint vao, GLuint count, const glm::vec3 &color, GLfloat outline, const glm::vec3 &outlineColor);
+	// Reads the cached distance field atlas of font into pixels; fails if it is missing or stale
+	GLboolean loadCache(const std::string &cacheFile, uint64_t sourceSize, uint64_t sourceTime, GLuint &size, std::vector<unsigned char> &pixels);
+	// Renders every glyph with FreeType and turns it into a distance field atlas
+	GLboolean generate(const std::string &font, GLuint &size, std::vector<unsigned char> &pixels);
+	// Writes the atlas and glyph metrics to cacheFile
+	void saveCache(const std::string &cacheFile, uint64_t sourceSize, uint64_t sourceTime, GLuint size, const std::vector<unsigned char> &pixels) const;
 };
 
 #endif 
\ No newline at end of file
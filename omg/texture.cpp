@@ -12,18 +12,38 @@
 
 
 Texture2D::Texture2D()
-	: Width(0), Height(0), Internal_Format(GL_RGB), Image_Format(GL_RGB), Wrap_S(GL_REPEAT), Wrap_T(GL_REPEAT), Filter_Min(GL_LINEAR), Filter_Max(GL_LINEAR)
+	: ID(0), Width(0), Height(0), Internal_Format(GL_RGB), Image_Format(GL_RGB), Wrap_S(GL_REPEAT), Wrap_T(GL_REPEAT), Filter_Min(GL_LINEAR), Filter_Max(GL_LINEAR), Region(0.0f, 0.0f, 1.0f, 1.0f)
 {
+#ifndef HEADLESS
 	glGenTextures(1, &this->ID);
+#endif
 }
 
-void Texture2D::Generate(GLuint width, GLuint height, unsigned char* data)
+#ifndef HEADLESS
+void Texture2D::Generate(GLuint width, GLuint height, const unsigned char* data, GLuint levels)
 {
 	this->Width = width;
 	this->Height = height;
 	// Create Texture
 	glBindTexture(GL_TEXTURE_2D, this->ID);
+	// Image data is tightly packed, so rows (e.g. of RGB images or small mip levels) aren't 4 byte aligned
+	GLint alignment;
+	glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
 	glTexImage2D(GL_TEXTURE_2D, 0, this->Internal_Format, width, height, 0, this->Image_Format, GL_UNSIGNED_BYTE, data);
+	// Upload precomputed mip levels, each follows the previous one in data
+	GLuint channels = this->Image_Format == GL_RGBA ? 4 : this->Image_Format == GL_RGB ? 3 : 1;
+	for (GLuint level = 1; level < levels; ++level)
+	{
+		data += width * height * channels;
+		width = width > 1 ? width / 2 : 1;
+		height = height > 1 ? height / 2 : 1;
+		glTexImage2D(GL_TEXTURE_2D, level, this->Internal_Format, width, height, 0, this->Image_Format, GL_UNSIGNED_BYTE, data);
+	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+	if (levels > 1 && this->Filter_Min == GL_LINEAR)
+		this->Filter_Min = GL_LINEAR_MIPMAP_LINEAR;
 	// Set Texture wrap and filter modes
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, this->Wrap_S);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, this->Wrap_T);
@@ -36,4 +56,5 @@ void Texture2D::Generate(GLuint width, GLuint height, unsigned char* data)
 void Texture2D::Bind() const
 {
 	glBindTexture(GL_TEXTURE_2D, this->ID);
-}
\ No newline at end of file
+}
+#endif
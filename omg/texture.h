@@ -9,7 +9,8 @@
 #ifndef TEXTURE_H
 #define TEXTURE_H
 
-#include <GL/glew.h>
+#include "gl_types.h"
+#include <glm/glm.hpp>
 
 // Texture2D is able to store and configure a texture in OpenGL.
 // It also hosts utility functions for easy management.
@@ -28,10 +29,12 @@ public:
 	GLuint Wrap_T; // Wrapping mode on T axis
 	GLuint Filter_Min; // Filtering mode if texture pixels < screen pixels
 	GLuint Filter_Max; // Filtering mode if texture pixels > screen pixels
+	// Sub-rectangle (u0, v0, u1, v1) of the GL texture this object refers to; all of it unless it lives in an atlas
+	glm::vec4 Region;
 					   // Constructor (sets default texture modes)
 	Texture2D();
-	// Generates texture from image data
-	void Generate(GLuint width, GLuint height, unsigned char* data);
+	// Generates texture from image data; data may hold further mip levels, each following the previous one
+	void Generate(GLuint width, GLuint height, const unsigned char* data, GLuint levels = 1);
 	// Binds the texture as the current active GL_TEXTURE_2D texture object
 	void Bind() const;
 };
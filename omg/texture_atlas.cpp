@@ -0,0 +1,86 @@
+/*******************************************************************
+** This code is part of Breakout.
+**
+** Breakout is free software: you can redistribute it and/or modify
+** it under the terms of the CC BY 4.0 license as published by
+** Creative Commons, either version 4 of the License, or (at your
+** option) any later version.
+******************************************************************/
+#include "texture_atlas.h"
+
+#include <algorithm>
+#include <cstring>
+
+// A row of images of (at most) the same height
+struct Shelf {
+	GLuint Page, Y, Height, Used;
+};
+
+GLuint AtlasPacker::Pack(std::vector<AtlasImage> &images) const
+{
+	// Place tallest images first so every shelf is filled with similar heights
+	std::vector<AtlasImage*> order;
+	for (AtlasImage &image : images)
+		order.push_back(&image);
+	std::stable_sort(order.begin(), order.end(),
+		[](const AtlasImage *a, const AtlasImage *b) { return a->Height > b->Height; });
+
+	std::vector<Shelf> shelves;
+	std::vector<GLuint> pageHeight; // Height used on each page
+	for (AtlasImage *image : order)
+	{
+		GLuint w = image->Width + 2 * this->Padding;
+		GLuint h = image->Height + 2 * this->Padding;
+		image->Page = NO_ATLAS_PAGE;
+		if (w > this->PageSize || h > this->PageSize)
+			continue;
+		// First try any existing shelf the image fits on
+		for (Shelf &shelf : shelves)
+		{
+			if (h <= shelf.Height && shelf.Used + w <= this->PageSize)
+			{
+				image->Page = shelf.Page;
+				image->X = shelf.Used + this->Padding;
+				image->Y = shelf.Y + this->Padding;
+				shelf.Used += w;
+				break;
+			}
+		}
+		if (image->Page != NO_ATLAS_PAGE)
+			continue;
+		// Otherwise open a new shelf, on a new page if needed
+		GLuint page = 0;
+		while (page < pageHeight.size() && pageHeight[page] + h > this->PageSize)
+			++page;
+		if (page == pageHeight.size())
+			pageHeight.push_back(0);
+		Shelf shelf = { page, pageHeight[page], h, w };
+		pageHeight[page] += h;
+		shelves.push_back(shelf);
+		image->Page = page;
+		image->X = this->Padding;
+		image->Y = shelf.Y + this->Padding;
+	}
+	return pageHeight.size();
+}
+
+void AtlasPacker::Blit(unsigned char *page, const AtlasImage &image) const
+{
+	GLint pad = this->Padding;
+	for (GLint y = -pad; y < (GLint)image.Height + pad; ++y)
+	{
+		// Rows (and below, columns) in the padding repeat the nearest edge of the image
+		GLint sy = std::min(std::max(y, 0), (GLint)image.Height - 1);
+		const unsigned char *src = image.Pixels + sy * image.Width * 4;
+		unsigned char *dst = page + ((image.Y + y) * this->PageSize + image.X) * 4;
+		memcpy(dst, src, image.Width * 4);
+		if (image.Opaque)
+			for (GLuint x = 0; x < image.Width; ++x)
+				dst[x * 4 + 3] = 255;
+		for (GLint x = 1; x <= pad; ++x)
+		{
+			memcpy(dst - x * 4, dst, 4);
+			memcpy(dst + (image.Width - 1 + x) * 4, dst + (image.Width - 1) * 4, 4);
+		}
+	}
+}
@@ -0,0 +1,51 @@
+/*******************************************************************
+** This code is part of Breakout.
+**
+** Breakout is free software: you can redistribute it and/or modify
+** it under the terms of the CC BY 4.0 license as published by
+** Creative Commons, either version 4 of the License, or (at your
+** option) any later version.
+******************************************************************/
+#ifndef TEXTURE_ATLAS_H
+#define TEXTURE_ATLAS_H
+#include <string>
+#include <vector>
+
+#include <GL/glew.h>
+
+
+// Page index of an image that is too large to be packed into any page
+const GLuint NO_ATLAS_PAGE = 0xFFFFFFFF;
+
+
+// An RGBA image to be placed into an atlas page
+struct AtlasImage {
+	std::string    Name;
+	GLuint         Width, Height;
+	const unsigned char *Pixels;
+	// Whether the alpha channel should be ignored (written as fully opaque)
+	GLboolean      Opaque;
+	// Placement, filled in by AtlasPacker::Pack
+	GLuint Page, X, Y;
+
+	AtlasImage() : Width(0), Height(0), Pixels(nullptr), Opaque(GL_FALSE), Page(NO_ATLAS_PAGE), X(0), Y(0) { }
+};
+
+
+// AtlasPacker places many small images into a few square pages using
+// shelf packing (tallest images first). Each image is surrounded by
+// Padding pixels that repeat its border, so linear filtering never
+// bleeds in texels of a neighbouring image.
+class AtlasPacker
+{
+public:
+	GLuint PageSize, Padding;
+	// Constructor
+	AtlasPacker(GLuint pageSize, GLuint padding = 1) : PageSize(pageSize), Padding(padding) { }
+	// Places all images, filling in their Page/X/Y; returns the number of pages used
+	GLuint Pack(std::vector<AtlasImage> &images) const;
+	// Copies an image into the RGBA pixels of its page, extruding its border into the padding
+	void   Blit(unsigned char *page, const AtlasImage &image) const;
+};
+
+#endif
@@ -0,0 +1,64 @@
+/*******************************************************************
+** This code is part of Breakout.
+**
+** Breakout is free software: you can redistribute it and/or modify
+** it under the terms of the CC BY 4.0 license as published by
+** Creative Commons, either version 4 of the License, or (at your
+** option) any later version.
+******************************************************************/
+#include "thread_pool.h"
+
+
+ThreadPool::ThreadPool(GLuint threads)
+	: stopping(false)
+{
+	if (threads == 0)
+		threads = std::thread::hardware_concurrency();
+	if (threads == 0)
+		threads = 4;
+	for (GLuint i = 0; i < threads; ++i)
+		this->workers.push_back(std::thread(&ThreadPool::run, this));
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		this->stopping = true;
+	}
+	this->wake.notify_all();
+	for (std::thread &worker : this->workers)
+		worker.join();
+}
+
+void ThreadPool::Submit(std::function<void()> task)
+{
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		this->tasks.push_back(std::move(task));
+	}
+	this->wake.notify_one();
+}
+
+GLuint ThreadPool::Size() const
+{
+	return this->workers.size();
+}
+
+void ThreadPool::run()
+{
+	for (;;)
+	{
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(this->mutex);
+			this->wake.wait(lock, [this] { return this->stopping || !this->tasks.empty(); });
+			// Drain the queue before stopping so nobody waits on a task that never ran
+			if (this->tasks.empty())
+				return;
+			task = std::move(this->tasks.front());
+			this->tasks.pop_front();
+		}
+		task();
+	}
+}
\ No newline at end of file
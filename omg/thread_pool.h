@@ -0,0 +1,47 @@
+/*******************************************************************
+** This code is part of Breakout.
+**
+** Breakout is free software: you can redistribute it and/or modify
+** it under the terms of the CC BY 4.0 license as published by
+** Creative Commons, either version 4 of the License, or (at your
+** option) any later version.
+******************************************************************/
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <GL/glew.h>
+
+
+// ThreadPool runs submitted tasks on a fixed set of worker threads.
+// Tasks must not touch OpenGL: only the thread owning the context may.
+class ThreadPool
+{
+public:
+	// Constructor, starts the workers (one per hardware thread if threads is 0)
+	ThreadPool(GLuint threads = 0);
+	// Destructor, finishes the queued tasks and joins the workers
+	~ThreadPool();
+	// Queues a task to run on one of the workers
+	void   Submit(std::function<void()> task);
+	// Number of worker threads
+	GLuint Size() const;
+private:
+	std::vector<std::thread>          workers;
+	std::deque<std::function<void()>> tasks;
+	std::mutex                        mutex;
+	std::condition_variable           wake;
+	bool                              stopping;
+	// Worker loop
+	void run();
+	// Not copyable
+	ThreadPool(const ThreadPool&);
+	ThreadPool &operator=(const ThreadPool&);
+};
+
+#endif
\ No newline at end of file